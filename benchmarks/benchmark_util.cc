@@ -0,0 +1,148 @@
+#include "benchmark_util.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "s2cell.h"
+#include "s2edgeutil.h"
+#include "s2loop.h"
+#include "s2polygon.h"
+#include "matrix3x3-inl.h"
+
+namespace s2_benchmark {
+
+S2LatLng const kCities[] = {
+  S2LatLng::FromDegrees(37.7749, -122.4194),   // San Francisco
+  S2LatLng::FromDegrees(40.7128, -74.0060),    // New York
+  S2LatLng::FromDegrees(51.5074, -0.1278),     // London
+  S2LatLng::FromDegrees(35.6762, 139.6503),    // Tokyo
+  S2LatLng::FromDegrees(-33.9249, 18.4241),    // Cape Town
+  S2LatLng::FromDegrees(-33.8688, 151.2093),   // Sydney
+};
+int const kNumCities = sizeof(kCities) / sizeof(kCities[0]);
+
+static double const kEarthRadiusMeters = 6371.0 * 1000.0;
+
+S1Angle MetersToAngle(double meters) {
+  return S1Angle::Radians(meters / kEarthRadiusMeters);
+}
+
+S2Cap CityCap(int city, double radius_meters) {
+  return S2Cap::FromAxisAngle(kCities[city % kNumCities].ToPoint(),
+                              MetersToAngle(radius_meters));
+}
+
+S2Point RandomPointInCap(S2Cap const& cap, std::mt19937_64* rng) {
+  std::uniform_real_distribution<double> uniform(0, 1);
+  Matrix3x3_d frame;
+  S2::GetFrame(cap.axis(), &frame);
+  // Choose the distance from the axis so that points are uniform by area.
+  double r = cap.angle().radians() * sqrt(uniform(*rng));
+  double theta = 2 * M_PI * uniform(*rng);
+  return S2::FromFrame(frame, S2Point(sin(r) * cos(theta),
+                                      sin(r) * sin(theta), cos(r)));
+}
+
+std::vector<S2Point> RandomCityPoints(int n, double radius_meters,
+                                      std::mt19937_64* rng) {
+  std::vector<S2Point> points;
+  points.reserve(n);
+  for (int k = 0; k < n; ++k) {
+    points.push_back(RandomPointInCap(CityCap(k, radius_meters), rng));
+  }
+  return points;
+}
+
+S2Loop* MakeCityLoop(S2Point const& center, double radius_meters,
+                     int num_vertices, double jitter, std::mt19937_64* rng) {
+  std::uniform_real_distribution<double> uniform(1 - jitter, 1);
+  Matrix3x3_d frame;
+  S2::GetFrame(center, &frame);
+  double const radius = MetersToAngle(radius_meters).radians();
+  std::vector<S2Point> vertices;
+  vertices.reserve(num_vertices);
+  for (int k = 0; k < num_vertices; ++k) {
+    double r = radius * uniform(*rng);
+    double theta = 2 * M_PI * k / num_vertices;
+    vertices.push_back(S2::FromFrame(
+        frame, S2Point(sin(r) * cos(theta), sin(r) * sin(theta), cos(r))));
+  }
+  return new S2Loop(vertices);
+}
+
+S2Polygon* MakeCityPolygon(S2Point const& center, double radius_meters,
+                           int num_vertices, double jitter,
+                           std::mt19937_64* rng) {
+  std::vector<S2Loop*> loops;
+  loops.push_back(MakeCityLoop(center, radius_meters, num_vertices, jitter,
+                               rng));
+  return new S2Polygon(&loops);
+}
+
+// Returns the corner at (i,j) of the leaf cell grid of the given face.
+static S2Point FaceIJCorner(int face, int64 i, int64 j) {
+  double const scale = 1.0 / S2CellId::kMaxSize;
+  return S2::FaceUVtoXYZ(face, S2::STtoUV(scale * i),
+                         S2::STtoUV(scale * j)).Normalize();
+}
+
+S2Loop* MakeCellAlignedLoop(S2CellId const& corner, int width, int height,
+                            int num_vertices) {
+  int i, j;
+  int const face = corner.ToFaceIJOrientation(&i, &j, NULL);
+  int const size = corner.GetSizeIJ();
+  int64 const i0 = i & -size, j0 = j & -size;
+  int64 const w = int64(width) * size, h = int64(height) * size;
+  int const per_side = num_vertices / 4;
+  // Counterclockwise in (i,j), which is counterclockwise on the sphere.
+  std::vector<S2Point> vertices;
+  vertices.reserve(num_vertices);
+  for (int k = 0; k < per_side; ++k) {
+    vertices.push_back(FaceIJCorner(face, i0 + k * w / per_side, j0));
+  }
+  for (int k = 0; k < per_side; ++k) {
+    vertices.push_back(FaceIJCorner(face, i0 + w, j0 + k * h / per_side));
+  }
+  for (int k = 0; k < per_side; ++k) {
+    vertices.push_back(FaceIJCorner(face, i0 + w - k * w / per_side,
+                                    j0 + h));
+  }
+  for (int k = 0; k < per_side; ++k) {
+    vertices.push_back(FaceIJCorner(face, i0, j0 + h - k * h / per_side));
+  }
+  return new S2Loop(vertices);
+}
+
+std::vector<S2Point> CellAlignedQueries(S2Loop const* loop, int level,
+                                        int num_corners,
+                                        std::mt19937_64* rng) {
+  std::vector<S2Point> points;
+  std::uniform_real_distribution<double> uniform(0, 1);
+  for (int k = 0; k < loop->num_vertices(); ++k) {
+    S2Point const& a = loop->vertex(k);
+    S2Point const& b = loop->vertex(k + 1);
+    points.push_back(a);
+    points.push_back(S2EdgeUtil::Interpolate(0.5, a, b));
+    points.push_back(S2EdgeUtil::Interpolate(uniform(*rng), a, b));
+  }
+  // Cells around the loop, including some outside it.
+  S2Cap const cap = loop->GetCapBound().Expanded(
+      S1Angle::Radians(S2::kMaxDiag.GetValue(level)));
+  for (int k = 0; k < num_corners; ++k) {
+    int const cell_level = std::min(S2CellId::kMaxLevel,
+                                    std::max(0, level - 2 + int((*rng)() % 9)));
+    S2Cell cell(S2CellId::FromPoint(RandomPointInCap(cap, rng))
+                .parent(cell_level));
+    points.push_back(cell.GetVertex((*rng)() % 4));
+  }
+  // A few units in the last place of a coordinate of a unit vector.
+  std::uniform_real_distribution<double> nudge(-4e-16, 4e-16);
+  for (int k = 0, n = points.size(); k < n; ++k) {
+    points.push_back((points[k] + S2Point(nudge(*rng), nudge(*rng),
+                                          nudge(*rng))).Normalize());
+  }
+  return points;
+}
+
+}  // namespace s2_benchmark
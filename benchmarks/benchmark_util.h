@@ -0,0 +1,90 @@
+// Helpers that generate realistic, city-scale inputs for the S2 benchmarks.
+// All inputs are generated from fixed seeds so that runs are comparable.
+
+#ifndef PGOAPI_BENCHMARKS_BENCHMARK_UTIL_H_
+#define PGOAPI_BENCHMARKS_BENCHMARK_UTIL_H_
+
+#include <random>
+#include <vector>
+
+#include "commandlineflags.h"
+#include "s1angle.h"
+#include "s2.h"
+#include "s2cap.h"
+#include "s2cellid.h"
+#include "s2latlng.h"
+
+class S2Loop;
+class S2Polygon;
+
+DECLARE_bool(s2loop_use_point_index);
+
+namespace s2_benchmark {
+
+// Sets FLAGS_s2loop_use_point_index for the lifetime of the object, e.g. so
+// that S2Loop::Contains() can serve as the exact reference for checks.
+class ScopedUsePointIndex {
+ public:
+  explicit ScopedUsePointIndex(bool value)
+      : saved_(FLAGS_s2loop_use_point_index) {
+    FLAGS_s2loop_use_point_index = value;
+  }
+  ~ScopedUsePointIndex() { FLAGS_s2loop_use_point_index = saved_; }
+
+ private:
+  bool const saved_;
+};
+
+// The city centres that inputs are generated around.
+extern S2LatLng const kCities[];
+extern int const kNumCities;
+
+// Returns the angle subtended by the given distance on the Earth's surface.
+S1Angle MetersToAngle(double meters);
+
+// Returns a cap of the given radius around the centre of city "city".
+S2Cap CityCap(int city, double radius_meters);
+
+// Returns a point uniformly distributed within "cap".
+S2Point RandomPointInCap(S2Cap const& cap, std::mt19937_64* rng);
+
+// Returns "n" points uniformly distributed within caps of the given radius
+// around the cities, cycling through the cities.
+std::vector<S2Point> RandomCityPoints(int n, double radius_meters,
+                                      std::mt19937_64* rng);
+
+// Returns a star-shaped loop with "num_vertices" vertices around "center",
+// shaped like a city boundary: the distance of each vertex from the center
+// varies randomly between (1 - jitter) and 1 times "radius_meters".  The
+// caller takes ownership.
+S2Loop* MakeCityLoop(S2Point const& center, double radius_meters,
+                     int num_vertices, double jitter, std::mt19937_64* rng);
+
+// Returns a polygon consisting of a single MakeCityLoop() loop.  The caller
+// takes ownership.
+S2Polygon* MakeCityPolygon(S2Point const& center, double radius_meters,
+                           int num_vertices, double jitter,
+                           std::mt19937_64* rng);
+
+// Returns a rectangular loop around the block of "width" by "height" cells
+// whose lower left (minimum i and j) cell is "corner", such as the border of
+// a region made of S2 cells.  Its "num_vertices" vertices are spread evenly
+// along the four sides, so every vertex and edge lies exactly on the
+// boundary of cells at the level of "corner".  "num_vertices" must be a
+// multiple of 4 and the block must not cross a cube face.  The caller
+// takes ownership.
+S2Loop* MakeCellAlignedLoop(S2CellId const& corner, int width, int height,
+                            int num_vertices);
+
+// Returns points that are hard to classify for polygons whose edges lie on
+// cell boundaries, like MakeCellAlignedLoop(): the vertices of "loop" and
+// points along its edges, the vertices of "num_corners" random cells around
+// it from two levels coarser than "level" to six levels finer, and copies
+// of all of these moved by a few units in the last place.
+std::vector<S2Point> CellAlignedQueries(S2Loop const* loop, int level,
+                                        int num_corners,
+                                        std::mt19937_64* rng);
+
+}  // namespace s2_benchmark
+
+#endif  // PGOAPI_BENCHMARKS_BENCHMARK_UTIL_H_
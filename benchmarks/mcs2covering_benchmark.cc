@@ -0,0 +1,47 @@
+// Benchmarks for the plain C covering API used by MCS2CellID, with and
+// without its covering cache.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "MCS2Covering.h"
+#include "benchmark_util.h"
+#include "s2latlng.h"
+
+namespace s2_benchmark {
+namespace {
+
+// The argument selects whether the covering cache is enabled.  Each
+// position is requested twice in a row, as a client that polls faster
+// than it moves would.
+void BM_MCS2GetCellIDsForRegion(benchmark::State& state) {
+  if (state.range(0)) {
+    MCS2EnableCoveringCache(20, 16 << 20);
+  } else {
+    MCS2DisableCoveringCache();
+  }
+  std::mt19937_64 rng(12345);
+  std::vector<S2Point> points = RandomCityPoints(256, 20000, &rng);
+  std::vector<S2LatLng> positions;
+  for (size_t k = 0; k < points.size(); ++k) {
+    positions.push_back(S2LatLng(points[k]));
+  }
+  uint64_t cell_ids[256];
+  for (auto _ : state) {
+    for (size_t k = 0; k < 2 * positions.size(); ++k) {
+      S2LatLng const& ll = positions[k / 2];
+      size_t n = MCS2GetCellIDsForRegion(ll.lat().degrees(),
+                                         ll.lng().degrees(), 1500, 15, 100,
+                                         cell_ids, 256);
+      benchmark::DoNotOptimize(n);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * positions.size());
+  MCS2DisableCoveringCache();
+}
+BENCHMARK(BM_MCS2GetCellIDsForRegion)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace s2_benchmark
@@ -0,0 +1,354 @@
+// Benchmarks for the S2CellId conversions, including the bulk
+// FromLatLngArray() path and the BMI2 Hilbert curve conversions, and checks
+// of the conversions against a reference implementation.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "commandlineflags.h"
+#include "s2cell.h"
+#include "s2cellid.h"
+#include "s2latlng.h"
+
+DECLARE_bool(s2cellid_use_bmi2);
+
+namespace s2_benchmark {
+namespace {
+
+int const kNumPoints = 1 << 16;
+
+// Fills "lat" and "lng" with points around the benchmark cities.
+void CityLatLngs(std::vector<double>* lat, std::vector<double>* lng) {
+  std::mt19937_64 rng(12345);
+  std::vector<S2Point> points = RandomCityPoints(kNumPoints, 20000, &rng);
+  lat->resize(points.size());
+  lng->resize(points.size());
+  for (size_t k = 0; k < points.size(); ++k) {
+    S2LatLng ll(points[k]);
+    (*lat)[k] = ll.lat().degrees();
+    (*lng)[k] = ll.lng().degrees();
+  }
+}
+
+void BM_FromLatLng(benchmark::State& state) {
+  std::vector<double> lat, lng;
+  CityLatLngs(&lat, &lng);
+  std::vector<uint64> out(lat.size());
+  for (auto _ : state) {
+    for (size_t k = 0; k < lat.size(); ++k) {
+      out[k] = S2CellId::FromLatLng(
+          S2LatLng::FromDegrees(lat[k], lng[k])).id();
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * lat.size());
+}
+BENCHMARK(BM_FromLatLng);
+
+void BM_FromLatLngArray(benchmark::State& state) {
+  std::vector<double> lat, lng;
+  CityLatLngs(&lat, &lng);
+  std::vector<uint64> out(lat.size()), expected(lat.size());
+  for (size_t k = 0; k < lat.size(); ++k) {
+    expected[k] = S2CellId::FromLatLng(
+        S2LatLng::FromDegrees(lat[k], lng[k])).id();
+  }
+  for (auto _ : state) {
+    S2CellId::FromLatLngArray(lat.data(), lng.data(), lat.size(),
+                              out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  if (out != expected) {
+    state.SkipWithError("FromLatLngArray() disagrees with FromLatLng()");
+  }
+  state.SetItemsProcessed(state.iterations() * lat.size());
+}
+BENCHMARK(BM_FromLatLngArray);
+
+struct FaceIJ {
+  int face, i, j;
+};
+
+// Returns random (face, i, j) leaf cell coordinates.
+std::vector<FaceIJ> RandomFaceIJs() {
+  std::mt19937_64 rng(12345);
+  std::vector<FaceIJ> input(kNumPoints);
+  for (size_t k = 0; k < input.size(); ++k) {
+    input[k].face = rng() % 6;
+    input[k].i = rng() & (S2CellId::kMaxSize - 1);
+    input[k].j = rng() & (S2CellId::kMaxSize - 1);
+  }
+  return input;
+}
+
+// The benchmarks below take one argument, which selects the BMI2 (1) or
+// lookup table (0) Hilbert curve conversions.  On CPUs without fast BMI2
+// support both use the lookup tables.
+class ScopedUseBMI2 {
+ public:
+  explicit ScopedUseBMI2(bool value) : saved_(FLAGS_s2cellid_use_bmi2) {
+    FLAGS_s2cellid_use_bmi2 = value;
+  }
+  ~ScopedUseBMI2() { FLAGS_s2cellid_use_bmi2 = saved_; }
+
+ private:
+  bool const saved_;
+};
+
+// Throughput over independent inputs.
+void BM_FromFaceIJ(benchmark::State& state) {
+  ScopedUseBMI2 use_bmi2(state.range(0));
+  std::vector<FaceIJ> input = RandomFaceIJs();
+  std::vector<S2CellId> out(input.size());
+  for (auto _ : state) {
+    for (size_t k = 0; k < input.size(); ++k) {
+      out[k] = S2CellId::FromFaceIJ(input[k].face, input[k].i, input[k].j);
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_FromFaceIJ)->Arg(0)->Arg(1);
+
+// Latency: each input depends on the previous result, which is closer to
+// how S2Cell::Init() and the region coverer use the conversion.
+void BM_FromFaceIJChain(benchmark::State& state) {
+  ScopedUseBMI2 use_bmi2(state.range(0));
+  uint64 x = 12345;
+  for (auto _ : state) {
+    x = S2CellId::FromFaceIJ(x % 6, (x >> 3) & (S2CellId::kMaxSize - 1),
+                             (x >> 33) & (S2CellId::kMaxSize - 1)).id();
+  }
+  benchmark::DoNotOptimize(x);
+}
+BENCHMARK(BM_FromFaceIJChain)->Arg(0)->Arg(1);
+
+void BM_ToFaceIJOrientation(benchmark::State& state) {
+  ScopedUseBMI2 use_bmi2(state.range(0));
+  std::mt19937_64 rng(54321);
+  std::vector<FaceIJ> input = RandomFaceIJs();
+  std::vector<S2CellId> cells(input.size());
+  for (size_t k = 0; k < input.size(); ++k) {
+    // Decode cells at every level, not just leaf cells.
+    cells[k] = S2CellId::FromFaceIJ(input[k].face, input[k].i, input[k].j)
+                   .parent(rng() % (S2CellId::kMaxLevel + 1));
+  }
+  std::vector<FaceIJ> out(cells.size());
+  std::vector<int> orientations(cells.size());
+  for (auto _ : state) {
+    for (size_t k = 0; k < cells.size(); ++k) {
+      out[k].face = cells[k].ToFaceIJOrientation(&out[k].i, &out[k].j,
+                                                 &orientations[k]);
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * cells.size());
+}
+BENCHMARK(BM_ToFaceIJOrientation)->Arg(0)->Arg(1);
+
+void BM_ToFaceIJOrientationChain(benchmark::State& state) {
+  ScopedUseBMI2 use_bmi2(state.range(0));
+  uint64 x = 12345;
+  for (auto _ : state) {
+    int i, j, orientation;
+    int face = S2CellId(x | 1).ToFaceIJOrientation(&i, &j, &orientation);
+    x = (static_cast<uint64>(i) << 34) ^
+        (static_cast<uint64>(j) * GG_ULONGLONG(0x9E3779B97F4A7C15)) ^
+        (orientation << 1) ^ (static_cast<uint64>(face) << 61);
+  }
+  benchmark::DoNotOptimize(x);
+}
+BENCHMARK(BM_ToFaceIJOrientationChain)->Arg(0)->Arg(1);
+
+// Checks that the two Hilbert curve implementations agree.
+void BM_HilbertImplementationsAgree(benchmark::State& state) {
+  std::vector<FaceIJ> input = RandomFaceIJs();
+  int mismatches = 0;
+  for (auto _ : state) {
+    mismatches = 0;
+    for (size_t k = 0; k < input.size(); ++k) {
+      FLAGS_s2cellid_use_bmi2 = false;
+      S2CellId a = S2CellId::FromFaceIJ(input[k].face, input[k].i,
+                                        input[k].j);
+      int ai, aj, ao;
+      int af = a.ToFaceIJOrientation(&ai, &aj, &ao);
+      FLAGS_s2cellid_use_bmi2 = true;
+      S2CellId b = S2CellId::FromFaceIJ(input[k].face, input[k].i,
+                                        input[k].j);
+      int bi, bj, bo;
+      int bf = b.ToFaceIJOrientation(&bi, &bj, &bo);
+      if (a != b || af != bf || ai != bi || aj != bj || ao != bo) {
+        ++mismatches;
+      }
+    }
+  }
+  if (mismatches > 0) {
+    state.SkipWithError("BMI2 and lookup table conversions disagree");
+  }
+}
+BENCHMARK(BM_HilbertImplementationsAgree)->Iterations(1);
+
+// The Hilbert curve conversions as they were before the lookup tables were
+// generated at compile time: the tables are filled at run time by the
+// original recursive subdivision, from private copies of the orientation
+// tables that used to be defined in s2.cc.  This is an independent check
+// that the compile-time tables are not just inverses of each other but
+// have the right orientation.
+class ReferenceHilbertCurve {
+ public:
+  ReferenceHilbertCurve()
+      : lookup_pos_(kLookupSize, -1), lookup_ij_(kLookupSize, -1),
+        pos_used_(kLookupSize, false), ij_used_(kLookupSize, false) {
+    InitLookupCell(0, 0, 0, 0, 0, 0);
+    InitLookupCell(0, 0, 0, kSwapMask, 0, kSwapMask);
+    InitLookupCell(0, 0, 0, kInvertMask, 0, kInvertMask);
+    InitLookupCell(0, 0, 0, kSwapMask | kInvertMask, 0,
+                   kSwapMask | kInvertMask);
+  }
+
+  S2CellId FromFaceIJ(int face, int i, int j) {
+    uint64 n = static_cast<uint64>(face) << (S2CellId::kPosBits - 1);
+    int bits = face & kSwapMask;
+    for (int k = 7; k >= 0; --k) {
+      int const mask = (1 << kLookupBits) - 1;
+      bits += ((i >> (k * kLookupBits)) & mask) << (kLookupBits + 2);
+      bits += ((j >> (k * kLookupBits)) & mask) << 2;
+      pos_used_[bits] = true;
+      bits = lookup_pos_[bits];
+      n |= static_cast<uint64>(bits >> 2) << (k * 2 * kLookupBits);
+      bits &= kSwapMask | kInvertMask;
+    }
+    return S2CellId(n * 2 + 1);
+  }
+
+  int ToFaceIJOrientation(S2CellId id, int* pi, int* pj, int* orientation) {
+    int i = 0, j = 0;
+    int face = id.face();
+    int bits = face & kSwapMask;
+    for (int k = 7; k >= 0; --k) {
+      int const nbits = (k == 7) ? (S2CellId::kMaxLevel - 7 * kLookupBits)
+                                 : kLookupBits;
+      bits += (static_cast<int>(id.id() >> (k * 2 * kLookupBits + 1)) &
+               ((1 << (2 * nbits)) - 1)) << 2;
+      ij_used_[bits] = true;
+      bits = lookup_ij_[bits];
+      i += (bits >> (kLookupBits + 2)) << (k * kLookupBits);
+      j += ((bits >> 2) & ((1 << kLookupBits) - 1)) << (k * kLookupBits);
+      bits &= kSwapMask | kInvertMask;
+    }
+    *pi = i;
+    *pj = j;
+    if (id.lsb() & GG_ULONGLONG(0x1111111111111110)) bits ^= kSwapMask;
+    *orientation = bits;
+    return face;
+  }
+
+  // Returns true if the conversions above have used every table entry.
+  bool AllEntriesUsed() const {
+    for (int k = 0; k < kLookupSize; ++k) {
+      if (!pos_used_[k] || !ij_used_[k]) return false;
+    }
+    return true;
+  }
+
+ private:
+  static int const kLookupBits = 4;
+  static int const kSwapMask = 0x01;
+  static int const kInvertMask = 0x02;
+  static int const kLookupSize = 1 << (2 * kLookupBits + 2);
+
+  void InitLookupCell(int level, int i, int j, int orig_orientation,
+                      int pos, int orientation) {
+    static int const kPosToIJ[4][4] = {
+      {  0, 1, 3, 2 },    // canonical order:    (0,0), (0,1), (1,1), (1,0)
+      {  0, 2, 3, 1 },    // axes swapped:       (0,0), (1,0), (1,1), (0,1)
+      {  3, 2, 0, 1 },    // bits inverted:      (1,1), (1,0), (0,0), (0,1)
+      {  3, 1, 0, 2 },    // swapped & inverted: (1,1), (0,1), (0,0), (1,0)
+    };
+    static int const kPosToOrientation[4] = {
+      kSwapMask, 0, 0, kInvertMask + kSwapMask,
+    };
+    if (level == kLookupBits) {
+      int ij = (i << kLookupBits) + j;
+      lookup_pos_[(ij << 2) + orig_orientation] = (pos << 2) + orientation;
+      lookup_ij_[(pos << 2) + orig_orientation] = (ij << 2) + orientation;
+    } else {
+      for (int child = 0; child < 4; ++child) {
+        int const r = kPosToIJ[orientation][child];
+        InitLookupCell(level + 1, (i << 1) + (r >> 1), (j << 1) + (r & 1),
+                       orig_orientation, (pos << 2) + child,
+                       orientation ^ kPosToOrientation[child]);
+      }
+    }
+  }
+
+  std::vector<int> lookup_pos_, lookup_ij_;
+  std::vector<bool> pos_used_, ij_used_;
+};
+
+// Checks both Hilbert curve implementations against ReferenceHilbertCurve,
+// for leaf cells and for cells at every level.
+void BM_HilbertMatchesReference(benchmark::State& state) {
+  std::mt19937_64 rng(54321);
+  std::vector<FaceIJ> input = RandomFaceIJs();
+  bool const saved_use_bmi2 = FLAGS_s2cellid_use_bmi2;
+  ReferenceHilbertCurve reference;
+  int mismatches = 0;
+  for (auto _ : state) {
+    mismatches = 0;
+    for (size_t k = 0; k < input.size(); ++k) {
+      S2CellId expected = reference.FromFaceIJ(input[k].face, input[k].i,
+                                               input[k].j);
+      S2CellId const parent =
+          expected.parent(rng() % (S2CellId::kMaxLevel + 1));
+      int ei, ej, eo, pi, pj, po;
+      int ef = reference.ToFaceIJOrientation(expected, &ei, &ej, &eo);
+      int pf = reference.ToFaceIJOrientation(parent, &pi, &pj, &po);
+      for (int use_bmi2 = 0; use_bmi2 < 2; ++use_bmi2) {
+        FLAGS_s2cellid_use_bmi2 = use_bmi2;
+        S2CellId actual = S2CellId::FromFaceIJ(input[k].face, input[k].i,
+                                               input[k].j);
+        int ai, aj, ao;
+        int af = actual.ToFaceIJOrientation(&ai, &aj, &ao);
+        if (actual != expected || af != ef || ai != ei || aj != ej ||
+            ao != eo) {
+          ++mismatches;
+        }
+        af = parent.ToFaceIJOrientation(&ai, &aj, &ao);
+        if (af != pf || ai != pi || aj != pj || ao != po) ++mismatches;
+      }
+    }
+  }
+  FLAGS_s2cellid_use_bmi2 = saved_use_bmi2;
+  if (mismatches > 0) {
+    state.SkipWithError("Hilbert curve conversions disagree with the "
+                        "runtime-built lookup tables");
+  } else if (!reference.AllEntriesUsed()) {
+    state.SkipWithError("the inputs do not cover every lookup table entry");
+  }
+}
+BENCHMARK(BM_HilbertMatchesReference)->Iterations(1);
+
+// S2Cell::Init() at the level that the Pokemon Go API requests.
+void BM_S2CellInit(benchmark::State& state) {
+  std::mt19937_64 rng(12345);
+  std::vector<S2Point> points = RandomCityPoints(kNumPoints, 20000, &rng);
+  std::vector<S2CellId> ids;
+  for (size_t k = 0; k < points.size(); ++k) {
+    ids.push_back(S2CellId::FromPoint(points[k]).parent(15));
+  }
+  for (auto _ : state) {
+    for (size_t k = 0; k < ids.size(); ++k) {
+      S2Cell cell(ids[k]);
+      benchmark::DoNotOptimize(&cell);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_S2CellInit);
+
+}  // namespace
+}  // namespace s2_benchmark
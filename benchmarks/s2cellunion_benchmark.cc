@@ -0,0 +1,596 @@
+// Benchmarks for S2CellUnion.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "coder.h"
+#include "s2cap.h"
+#include "s2cellid.h"
+#include "s2cellunion.h"
+#include "s2cellunionindex.h"
+#include "s2cellunionview.h"
+#include "s2regioncoverer.h"
+
+namespace s2_benchmark {
+namespace {
+
+// Returns "n" shuffled cells around the benchmark cities at levels 10 to 20,
+// including many cells that contain others.
+std::vector<S2CellId> RandomCityCells(int n) {
+  std::mt19937_64 rng(12345);
+  std::vector<S2Point> points = RandomCityPoints(n, 20000, &rng);
+  std::vector<S2CellId> cells;
+  for (size_t k = 0; k < points.size(); ++k) {
+    cells.push_back(S2CellId::FromPoint(points[k]).parent(10 + rng() % 11));
+  }
+  return cells;
+}
+
+// Returns "cells" normalized the way S2CellUnion::Normalize() did before it
+// used radix sorts and in-place output: std::sort, then one pass that
+// appends each cell to a new vector.
+std::vector<S2CellId> ReferenceNormalize(std::vector<S2CellId> cells) {
+  std::sort(cells.begin(), cells.end());
+  std::vector<S2CellId> output;
+  for (size_t i = 0; i < cells.size(); ++i) {
+    S2CellId id = cells[i];
+    if (!output.empty() && output.back().contains(id)) continue;
+    while (!output.empty() && id.contains(output.back())) {
+      output.pop_back();
+    }
+    while (output.size() >= 3) {
+      if ((output.end()[-3].id() ^ output.end()[-2].id() ^ output.back().id())
+          != id.id())
+        break;
+      uint64 mask = id.lsb() << 1;
+      mask = ~(mask + (mask << 1));
+      uint64 id_masked = (id.id() & mask);
+      if ((output.end()[-3].id() & mask) != id_masked ||
+          (output.end()[-2].id() & mask) != id_masked ||
+          (output.end()[-1].id() & mask) != id_masked ||
+          id.is_face())
+        break;
+      output.erase(output.end() - 3, output.end());
+      id = id.parent();
+    }
+    output.push_back(id);
+  }
+  return output;
+}
+
+// The arguments are the number of input cells and the number of threads.
+void BM_Normalize(benchmark::State& state) {
+  std::vector<S2CellId> const cells = RandomCityCells(state.range(0));
+  for (auto _ : state) {
+    std::vector<S2CellId> copy = cells;
+    S2CellUnion cell_union;
+    cell_union.InitRawSwap(&copy);
+    cell_union.Normalize(state.range(1));
+    benchmark::DoNotOptimize(cell_union.num_cells());
+  }
+  state.SetItemsProcessed(state.iterations() * cells.size());
+
+  // Check one more normalization, which reuses this thread's sort buffer,
+  // against the reference.
+  std::vector<S2CellId> copy = cells;
+  S2CellUnion cell_union;
+  cell_union.InitRawSwap(&copy);
+  cell_union.Normalize(state.range(1));
+  if (cell_union.cell_ids() != ReferenceNormalize(cells)) {
+    state.SkipWithError("Normalize() disagrees with the std::sort reference");
+  }
+}
+BENCHMARK(BM_Normalize)
+    ->Ranges({{64, 1 << 22}, {1, 1}})->Args({1 << 22, 4})->UseRealTime();
+
+void BM_ContainsCellId(benchmark::State& state) {
+  S2CellUnion cell_union;
+  cell_union.Init(RandomCityCells(state.range(0)));
+  std::mt19937_64 rng(54321);
+  std::vector<S2Point> points = RandomCityPoints(4096, 20000, &rng);
+  std::vector<S2CellId> queries;
+  for (size_t k = 0; k < points.size(); ++k) {
+    queries.push_back(S2CellId::FromPoint(points[k]));
+  }
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < queries.size(); ++k) {
+      count += cell_union.Contains(queries[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_ContainsCellId)->Range(64, 1 << 18);
+
+// The per-cell binary search implementations of S2CellUnion::Contains() and
+// Intersects() for cell unions, for comparison.
+bool ContainsByCell(S2CellUnion const& x, S2CellUnion const& y) {
+  for (int i = 0; i < y.num_cells(); ++i) {
+    if (!x.Contains(y.cell_id(i))) return false;
+  }
+  return true;
+}
+
+bool IntersectsByCell(S2CellUnion const& x, S2CellUnion const& y) {
+  for (int i = 0; i < y.num_cells(); ++i) {
+    if (x.Intersects(y.cell_id(i))) return true;
+  }
+  return false;
+}
+
+// A geofence of "n" scattered cells around the benchmark cities queried with
+// the level 15 coverings of 1.5km scan caps, half of which are then made to
+// lie within the geofence.
+struct GeofenceQueries {
+  explicit GeofenceQueries(int n) {
+    geofence.Init(RandomCityCells(n));
+    std::mt19937_64 rng(54321);
+    std::vector<S2Point> centers = RandomCityPoints(256, 20000, &rng);
+    S2RegionCoverer coverer;
+    coverer.set_min_level(15);
+    coverer.set_max_level(15);
+    coverer.set_max_cells(100);
+    for (size_t k = 0; k < centers.size(); ++k) {
+      vector<S2CellId> covering;
+      coverer.GetCovering(
+          S2Cap::FromAxisAngle(centers[k], MetersToAngle(1500)), &covering);
+      scans.emplace_back(new S2CellUnion);
+      scans.back()->InitSwap(&covering);
+    }
+    std::vector<S2CellId> cells = geofence.cell_ids();
+    for (size_t k = 0; k < scans.size(); k += 2) {
+      cells.insert(cells.end(), scans[k]->cell_ids().begin(),
+                   scans[k]->cell_ids().end());
+    }
+    geofence.InitSwap(&cells);
+  }
+
+  S2CellUnion geofence;
+  std::vector<std::unique_ptr<S2CellUnion> > scans;
+};
+
+// The argument is the number of geofence cells.
+void BM_ContainsCellUnion(benchmark::State& state) {
+  GeofenceQueries q(state.range(0));
+  for (size_t k = 0; k < q.scans.size(); ++k) {
+    if (q.geofence.Contains(q.scans[k].get()) !=
+        ContainsByCell(q.geofence, *q.scans[k])) {
+      state.SkipWithError("Contains() disagrees with the per-cell search");
+    }
+  }
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < q.scans.size(); ++k) {
+      count += q.geofence.Contains(q.scans[k].get());
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * q.scans.size());
+}
+BENCHMARK(BM_ContainsCellUnion)->Range(1 << 10, 1 << 16);
+
+void BM_ContainsCellUnionByCell(benchmark::State& state) {
+  GeofenceQueries q(state.range(0));
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < q.scans.size(); ++k) {
+      count += ContainsByCell(q.geofence, *q.scans[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * q.scans.size());
+}
+BENCHMARK(BM_ContainsCellUnionByCell)->Range(1 << 10, 1 << 16);
+
+void BM_IntersectsCellUnion(benchmark::State& state) {
+  GeofenceQueries q(state.range(0));
+  for (size_t k = 0; k < q.scans.size(); ++k) {
+    if (q.geofence.Intersects(q.scans[k].get()) !=
+            IntersectsByCell(q.geofence, *q.scans[k]) ||
+        q.scans[k]->Intersects(&q.geofence) !=
+            IntersectsByCell(q.geofence, *q.scans[k])) {
+      state.SkipWithError("Intersects() disagrees with the per-cell search");
+    }
+  }
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < q.scans.size(); ++k) {
+      count += q.geofence.Intersects(q.scans[k].get());
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * q.scans.size());
+}
+BENCHMARK(BM_IntersectsCellUnion)->Range(1 << 10, 1 << 16);
+
+void BM_IntersectsCellUnionByCell(benchmark::State& state) {
+  GeofenceQueries q(state.range(0));
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < q.scans.size(); ++k) {
+      count += IntersectsByCell(q.geofence, *q.scans[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * q.scans.size());
+}
+BENCHMARK(BM_IntersectsCellUnionByCell)->Range(1 << 10, 1 << 16);
+
+// A large union of cells scattered over the whole sphere, as used for
+// point-in-region tests against big geofences.
+void RandomGlobalUnion(int n, S2CellUnion* cell_union) {
+  std::mt19937_64 rng(12345);
+  std::vector<S2CellId> cells;
+  for (int k = 0; k < n; ++k) {
+    S2CellId id((rng() % (GG_ULONGLONG(6) << S2CellId::kPosBits)) | 1);
+    cells.push_back(id.parent(12 + rng() % 8));
+  }
+  cell_union->InitSwap(&cells);
+}
+
+// Points near the union's cells (about half of them inside), in random order.
+std::vector<S2Point> PointsNearUnion(S2CellUnion const& cell_union) {
+  std::mt19937_64 rng(54321);
+  std::vector<S2Point> points;
+  for (int k = 0; k < 1 << 16; ++k) {
+    S2CellId id = cell_union.cell_id(rng() % cell_union.num_cells());
+    if (k & 1) id = id.next_wrap();
+    points.push_back(id.child_begin(S2CellId::kMaxLevel).ToPoint());
+  }
+  return points;
+}
+
+// The argument is the number of cells before normalization.
+void BM_ContainsPointLarge(benchmark::State& state) {
+  S2CellUnion cell_union;
+  RandomGlobalUnion(state.range(0), &cell_union);
+  std::vector<S2Point> points = PointsNearUnion(cell_union);
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < points.size(); ++k) {
+      count += cell_union.Contains(points[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_ContainsPointLarge)->Range(1 << 12, 1 << 22);
+
+void BM_IndexContainsPoint(benchmark::State& state) {
+  S2CellUnion cell_union;
+  RandomGlobalUnion(state.range(0), &cell_union);
+  S2CellUnionIndex index(cell_union);
+  std::vector<S2Point> points = PointsNearUnion(cell_union);
+  for (size_t k = 0; k < points.size(); ++k) {
+    S2CellId id = S2CellId::FromPoint(points[k]).parent(k % 31);
+    if (index.Contains(points[k]) != cell_union.Contains(points[k]) ||
+        index.Contains(id) != cell_union.Contains(id) ||
+        index.Intersects(id) != cell_union.Intersects(id)) {
+      state.SkipWithError("S2CellUnionIndex disagrees with S2CellUnion");
+      break;
+    }
+  }
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < points.size(); ++k) {
+      count += index.Contains(points[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_IndexContainsPoint)->Range(1 << 12, 1 << 22);
+
+void BM_ContainsCellIdLarge(benchmark::State& state) {
+  S2CellUnion cell_union;
+  RandomGlobalUnion(state.range(0), &cell_union);
+  std::vector<S2Point> points = PointsNearUnion(cell_union);
+  std::vector<S2CellId> ids;
+  for (size_t k = 0; k < points.size(); ++k) {
+    ids.push_back(S2CellId::FromPoint(points[k]));
+  }
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < ids.size(); ++k) {
+      count += cell_union.Contains(ids[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_ContainsCellIdLarge)->Range(1 << 12, 1 << 22);
+
+void BM_IndexContainsCellId(benchmark::State& state) {
+  S2CellUnion cell_union;
+  RandomGlobalUnion(state.range(0), &cell_union);
+  S2CellUnionIndex index(cell_union);
+  std::vector<S2Point> points = PointsNearUnion(cell_union);
+  std::vector<S2CellId> ids;
+  for (size_t k = 0; k < points.size(); ++k) {
+    ids.push_back(S2CellId::FromPoint(points[k]));
+  }
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < ids.size(); ++k) {
+      count += index.Contains(ids[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_IndexContainsCellId)->Range(1 << 12, 1 << 22);
+
+// Map objects (spawn points and forts) checked against a geofence of 64k
+// cells around the benchmark cities.  The argument is the batch size.
+void BM_ContainsPointsOneByOne(benchmark::State& state) {
+  S2CellUnion geofence;
+  geofence.Init(RandomCityCells(1 << 16));
+  std::mt19937_64 rng(54321);
+  std::vector<S2Point> points = RandomCityPoints(state.range(0), 20000, &rng);
+  std::vector<uint64> hits;
+  for (auto _ : state) {
+    hits.assign((points.size() + 63) / 64, 0);
+    for (size_t k = 0; k < points.size(); ++k) {
+      if (geofence.Contains(points[k])) {
+        hits[k / 64] |= GG_ULONGLONG(1) << (k % 64);
+      }
+    }
+    benchmark::DoNotOptimize(hits.data());
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_ContainsPointsOneByOne)->Range(64, 1 << 20);
+
+// The second argument is the number of threads.
+void BM_ContainsPointsBatch(benchmark::State& state) {
+  S2CellUnion geofence;
+  geofence.Init(RandomCityCells(1 << 16));
+  std::mt19937_64 rng(54321);
+  std::vector<S2Point> points = RandomCityPoints(state.range(0), 20000, &rng);
+  std::vector<uint64> hits;
+  geofence.ContainsPoints(points.data(), points.size(), &hits,
+                          state.range(1));
+  for (size_t k = 0; k < points.size(); ++k) {
+    if (((hits[k / 64] >> (k % 64)) & 1) != geofence.Contains(points[k])) {
+      state.SkipWithError("ContainsPoints() disagrees with Contains()");
+      break;
+    }
+  }
+  for (auto _ : state) {
+    geofence.ContainsPoints(points.data(), points.size(), &hits,
+                            state.range(1));
+    benchmark::DoNotOptimize(hits.data());
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_ContainsPointsBatch)
+    ->Ranges({{64, 1 << 20}, {1, 1}})->Args({1 << 20, 4})->UseRealTime();
+
+// The same against a union of 1M cells scattered over the sphere, which
+// does not fit in cache.
+void BM_ContainsPointsOneByOneLarge(benchmark::State& state) {
+  S2CellUnion cell_union;
+  RandomGlobalUnion(1 << 20, &cell_union);
+  std::vector<S2Point> points = PointsNearUnion(cell_union);
+  points.resize(state.range(0));
+  std::vector<uint64> hits;
+  for (auto _ : state) {
+    hits.assign((points.size() + 63) / 64, 0);
+    for (size_t k = 0; k < points.size(); ++k) {
+      if (cell_union.Contains(points[k])) {
+        hits[k / 64] |= GG_ULONGLONG(1) << (k % 64);
+      }
+    }
+    benchmark::DoNotOptimize(hits.data());
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_ContainsPointsOneByOneLarge)->Range(64, 1 << 16);
+
+void BM_ContainsPointsBatchLarge(benchmark::State& state) {
+  S2CellUnion cell_union;
+  RandomGlobalUnion(1 << 20, &cell_union);
+  std::vector<S2Point> points = PointsNearUnion(cell_union);
+  points.resize(state.range(0));
+  std::vector<uint64> hits;
+  cell_union.ContainsPoints(points.data(), points.size(), &hits);
+  for (size_t k = 0; k < points.size(); ++k) {
+    if (((hits[k / 64] >> (k % 64)) & 1) != cell_union.Contains(points[k])) {
+      state.SkipWithError("ContainsPoints() disagrees with Contains()");
+      break;
+    }
+  }
+  for (auto _ : state) {
+    cell_union.ContainsPoints(points.data(), points.size(), &hits);
+    benchmark::DoNotOptimize(hits.data());
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_ContainsPointsBatchLarge)->Range(64, 1 << 16);
+
+// A RandomGlobalUnion() geofence of "n" cells written to a temporary file,
+// as it would be shipped to worker processes.
+struct GeofenceFile {
+  explicit GeofenceFile(int n) {
+    RandomGlobalUnion(n, &cell_union);
+    char name[] = "/tmp/s2_benchmark_geofence_XXXXXX";
+    int fd = mkstemp(name);
+    path = name;
+    FILE* file = fdopen(fd, "wb");
+    fwrite(&cell_union.cell_ids()[0], sizeof(S2CellId),
+           cell_union.num_cells(), file);
+    fclose(file);
+  }
+  ~GeofenceFile() { unlink(path.c_str()); }
+
+  S2CellUnion cell_union;
+  std::string path;
+};
+
+// Startup cost of a worker: load a geofence file (already in the page
+// cache) and answer one query.  The argument is the number of cells before
+// normalization.
+void BM_LoadGeofenceCopy(benchmark::State& state) {
+  GeofenceFile geofence(state.range(0));
+  S2Point const point = geofence.cell_union.cell_id(0).ToPoint();
+  for (auto _ : state) {
+    FILE* file = fopen(geofence.path.c_str(), "rb");
+    std::vector<S2CellId> cells(geofence.cell_union.num_cells());
+    if (fread(&cells[0], sizeof(S2CellId), cells.size(), file) !=
+        cells.size()) {
+      state.SkipWithError("short read");
+    }
+    fclose(file);
+    S2CellUnion cell_union;
+    cell_union.InitRawSwap(&cells);
+    benchmark::DoNotOptimize(cell_union.Contains(point));
+  }
+}
+BENCHMARK(BM_LoadGeofenceCopy)->Range(1 << 12, 1 << 22);
+
+void BM_LoadGeofenceView(benchmark::State& state) {
+  GeofenceFile geofence(state.range(0));
+  S2Point const point = geofence.cell_union.cell_id(0).ToPoint();
+  for (auto _ : state) {
+    std::unique_ptr<S2CellUnionView> view(
+        S2CellUnionView::Map(geofence.path.c_str()));
+    if (view == nullptr || !view->Contains(point)) {
+      state.SkipWithError("Map() failed");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_LoadGeofenceView)->Range(1 << 12, 1 << 22);
+
+// Queries against a view cost the same as against the cell union itself
+// (compare with BM_ContainsPointLarge).
+void BM_ViewContainsPointLarge(benchmark::State& state) {
+  S2CellUnion cell_union;
+  RandomGlobalUnion(state.range(0), &cell_union);
+  S2CellUnionView view(
+      reinterpret_cast<uint64 const*>(&cell_union.cell_ids()[0]),
+      cell_union.num_cells());
+  std::vector<S2Point> points = PointsNearUnion(cell_union);
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < points.size(); ++k) {
+      count += view.Contains(points[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_ViewContainsPointLarge)->Range(1 << 12, 1 << 22);
+
+// A coverage map made of level 15 coverings of "num_caps" 10km caps around
+// the benchmark cities, normalized into a single cell union.
+void CityCoverage(int num_caps, S2CellUnion* cell_union) {
+  std::mt19937_64 rng(12345);
+  std::vector<S2Point> centers = RandomCityPoints(num_caps, 50000, &rng);
+  S2RegionCoverer coverer;
+  coverer.set_min_level(15);
+  coverer.set_max_level(15);
+  coverer.set_max_cells(1 << 30);
+  std::vector<S2CellId> cells, covering;
+  for (size_t k = 0; k < centers.size(); ++k) {
+    coverer.GetCovering(S2Cap::FromAxisAngle(centers[k], MetersToAngle(10000)),
+                        &covering);
+    cells.insert(cells.end(), covering.begin(), covering.end());
+  }
+  cell_union->InitSwap(&cells);
+}
+
+// The argument is the number of caps in the coverage map.  "bytes_per_cell"
+// is the encoded size relative to the normalized union.
+void BM_EncodeCellUnion(benchmark::State& state) {
+  S2CellUnion cell_union;
+  CityCoverage(state.range(0), &cell_union);
+  Encoder encoder;
+
+  // The same cells split into their children are sorted and disjoint but
+  // not normalized.  Encode() must write their normalized form so that
+  // they decode to the original union.
+  std::vector<S2CellId> children;
+  for (int i = 0; i < cell_union.num_cells(); ++i) {
+    S2CellId const id = cell_union.cell_id(i);
+    if (id.is_leaf()) {
+      children.push_back(id);
+      continue;
+    }
+    for (S2CellId c = id.child_begin(); c != id.child_end(); c = c.next()) {
+      children.push_back(c);
+    }
+  }
+  S2CellUnion raw;
+  raw.InitRawSwap(&children);
+  raw.Encode(&encoder);
+  Decoder raw_decoder(encoder.base(), encoder.length());
+  S2CellUnion raw_decoded;
+  if (!raw_decoded.Decode(&raw_decoder) || !(raw_decoded == cell_union)) {
+    state.SkipWithError("a non-normalized union did not round-trip");
+  }
+  for (auto _ : state) {
+    encoder.clear();
+    cell_union.Encode(&encoder);
+    benchmark::DoNotOptimize(encoder.base());
+  }
+  state.counters["bytes_per_cell"] =
+      static_cast<double>(encoder.length()) / cell_union.num_cells();
+  state.SetBytesProcessed(state.iterations() * cell_union.num_cells() *
+                          sizeof(S2CellId));
+}
+BENCHMARK(BM_EncodeCellUnion)->Range(1, 256);
+
+// Bytes processed are those of the decoded cell ids, so that the throughput
+// can be compared with BM_DecodeRawCellIds.
+void BM_DecodeCellUnion(benchmark::State& state) {
+  S2CellUnion cell_union;
+  CityCoverage(state.range(0), &cell_union);
+  Encoder encoder;
+  cell_union.Encode(&encoder);
+  S2CellUnion decoded;
+  for (auto _ : state) {
+    Decoder decoder(encoder.base(), encoder.length());
+    if (!decoded.Decode(&decoder)) {
+      state.SkipWithError("Decode() failed");
+      break;
+    }
+  }
+  if (!(decoded == cell_union)) {
+    state.SkipWithError("Decode() did not reproduce the cell union");
+  }
+  state.SetBytesProcessed(state.iterations() * cell_union.num_cells() *
+                          sizeof(S2CellId));
+}
+BENCHMARK(BM_DecodeCellUnion)->Range(1, 256);
+
+// The same cells stored as raw 8-byte ids, as they used to be shipped.
+void BM_DecodeRawCellIds(benchmark::State& state) {
+  S2CellUnion cell_union;
+  CityCoverage(state.range(0), &cell_union);
+  std::vector<S2CellId> const& cells = cell_union.cell_ids();
+  size_t const size = cells.size() * sizeof(S2CellId);
+  std::vector<S2CellId> decoded;
+  for (auto _ : state) {
+    Decoder decoder(cells.data(), size);
+    decoded.resize(cells.size());
+    decoder.getn(decoded.data(), size);
+    benchmark::DoNotOptimize(decoded.data());
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_DecodeRawCellIds)->Range(1, 256);
+
+}  // namespace
+}  // namespace s2_benchmark
@@ -0,0 +1,85 @@
+// Benchmarks for building and querying S2EdgeIndex on city-shaped loops.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "s2edgeindex.h"
+#include "s2loop.h"
+#include "scoped_ptr.h"
+
+namespace s2_benchmark {
+namespace {
+
+// An edge index over the edges of a loop.
+class LoopEdgeIndex : public S2EdgeIndex {
+ public:
+  explicit LoopEdgeIndex(S2Loop const* loop) : loop_(loop) {}
+
+  virtual int num_edges() const { return loop_->num_vertices(); }
+  virtual S2Point const* edge_from(int index) const {
+    return &loop_->vertex(index);
+  }
+  virtual S2Point const* edge_to(int index) const {
+    return &loop_->vertex(index + 1);
+  }
+
+ private:
+  S2Loop const* loop_;
+};
+
+S2Loop* MakeBenchmarkLoop(int num_vertices) {
+  std::mt19937_64 rng(12345);
+  return MakeCityLoop(kCities[0].ToPoint(), 5000, num_vertices, 0.3, &rng);
+}
+
+// The arguments are the number of loop vertices and the number of threads.
+void BM_EdgeIndexBuild(benchmark::State& state) {
+  scoped_ptr<S2Loop> loop(MakeBenchmarkLoop(state.range(0)));
+  for (auto _ : state) {
+    LoopEdgeIndex index(loop.get());
+    index.ComputeIndex(state.range(1));
+    benchmark::DoNotOptimize(index.IsIndexComputed());
+  }
+  state.SetItemsProcessed(state.iterations() * loop->num_vertices());
+}
+BENCHMARK(BM_EdgeIndexBuild)
+    ->Args({256, 1})->Args({4096, 1})->Args({65536, 1})
+    ->Args({65536, 2})->Args({65536, 4})->UseRealTime();
+
+// Queries the index with 500m edges starting at random points in the loop's
+// bounding cap.  The "candidates" counter is the average number of
+// candidate edges returned per query.
+void BM_EdgeIndexQuery(benchmark::State& state) {
+  scoped_ptr<S2Loop> loop(MakeBenchmarkLoop(state.range(0)));
+  LoopEdgeIndex index(loop.get());
+  index.ComputeIndex();
+  std::mt19937_64 rng(54321);
+  S2Cap const cap = CityCap(0, 5000);
+  std::vector<S2Point> queries;
+  for (int k = 0; k < 1024; ++k) {
+    S2Point a = RandomPointInCap(cap, &rng);
+    queries.push_back(a);
+    queries.push_back(RandomPointInCap(
+        S2Cap::FromAxisAngle(a, MetersToAngle(500)), &rng));
+  }
+  S2EdgeIndex::Iterator it(&index);
+  int candidates = 0;
+  for (auto _ : state) {
+    candidates = 0;
+    for (size_t k = 0; k < queries.size(); k += 2) {
+      for (it.GetCandidates(queries[k], queries[k + 1]); !it.Done();
+           it.Next()) {
+        ++candidates;
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size() / 2);
+  state.counters["candidates"] = 2.0 * candidates / queries.size();
+}
+BENCHMARK(BM_EdgeIndexQuery)->Arg(256)->Arg(4096)->Arg(65536);
+
+}  // namespace
+}  // namespace s2_benchmark
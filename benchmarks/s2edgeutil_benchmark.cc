@@ -0,0 +1,62 @@
+// Benchmarks for testing a fixed edge against long vertex chains with
+// S2EdgeUtil::EdgeCrosser, one vertex at a time and in batches.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "s2edgeutil.h"
+#include "s2loop.h"
+#include "scoped_ptr.h"
+
+namespace s2_benchmark {
+namespace {
+
+// Counts the crossings between the edges of a city-shaped loop and edges
+// from S2::Origin() to random points near the loop, which is what
+// S2Loop::Contains(S2Point) does for loops without an index.  The arguments
+// are the number of loop vertices and the method: one EdgeOrVertexCrossing()
+// call per vertex (0), or one CountEdgeOrVertexCrossings() call (1).  On
+// CPUs without AVX2 the two are the same.
+void BM_EdgeCrosserChain(benchmark::State& state) {
+  std::mt19937_64 rng(12345);
+  scoped_ptr<S2Loop> loop(MakeCityLoop(kCities[0].ToPoint(), 5000,
+                                       state.range(0), 0.3, &rng));
+  std::vector<S2Point> vertices;
+  for (int i = 0; i < loop->num_vertices(); ++i) {
+    vertices.push_back(loop->vertex(i));
+  }
+  vertices.push_back(loop->vertex(0));
+  S2Cap const cap = CityCap(0, 7000);
+  std::vector<S2Point> queries;
+  for (int k = 0; k < 64; ++k) {
+    queries.push_back(RandomPointInCap(cap, &rng));
+  }
+  S2Point const origin = S2::Origin();
+  bool const batch = state.range(1);
+  int const n = vertices.size() - 1;
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < queries.size(); ++k) {
+      S2EdgeUtil::EdgeCrosser crosser(&origin, &queries[k], &vertices[0]);
+      if (!batch) {
+        for (int i = 1; i <= n; ++i) {
+          count += crosser.EdgeOrVertexCrossing(&vertices[i]);
+        }
+      } else {
+        count += crosser.CountEdgeOrVertexCrossings(&vertices[1], n);
+      }
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size() * n);
+}
+BENCHMARK(BM_EdgeCrosserChain)
+    ->Args({256, 0})->Args({256, 1})
+    ->Args({4096, 0})->Args({4096, 1})
+    ->Args({65536, 0})->Args({65536, 1});
+
+}  // namespace
+}  // namespace s2_benchmark
@@ -0,0 +1,122 @@
+// Benchmarks for S2Loop operations on city-shaped loops.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "s2cellid.h"
+#include "s2loop.h"
+#include "scoped_ptr.h"
+
+namespace s2_benchmark {
+namespace {
+
+// The arguments are the number of loop vertices and whether the loop may
+// build its point index.
+void BM_LoopContainsPoint(benchmark::State& state) {
+  ScopedUsePointIndex use_point_index(state.range(1));
+  std::mt19937_64 rng(12345);
+  S2Point const center = kCities[0].ToPoint();
+  scoped_ptr<S2Loop> loop(MakeCityLoop(center, 5000, state.range(0), 0.3,
+                                       &rng));
+  // Query points in the loop's bounding cap, so that about half of them are
+  // inside and the bounding rectangle test rarely short-circuits.
+  S2Cap const cap = S2Cap::FromAxisAngle(center, MetersToAngle(5000));
+  std::vector<S2Point> queries;
+  for (int k = 0; k < 4096; ++k) {
+    queries.push_back(RandomPointInCap(cap, &rng));
+  }
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < queries.size(); ++k) {
+      count += loop->Contains(queries[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_LoopContainsPoint)
+    ->ArgsProduct({{16, 64, 256, 1024, 4096}, {0, 1}});
+
+// Freezing a loop, which builds the edge index and the point index used by
+// Contains(S2Point).  The argument is the number of loop vertices.
+void BM_LoopFreeze(benchmark::State& state) {
+  ScopedUsePointIndex use_point_index(true);
+  std::mt19937_64 rng(12345);
+  scoped_ptr<S2Loop> loop(MakeCityLoop(kCities[0].ToPoint(), 5000,
+                                       state.range(0), 0.3, &rng));
+  for (auto _ : state) {
+    scoped_ptr<S2Loop> copy(loop->Clone());
+    copy->Freeze();
+    benchmark::DoNotOptimize(copy->is_frozen());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LoopFreeze)->Arg(256)->Arg(1024)->Arg(4096);
+
+// Queries on and right next to the edges of a loop that runs along cell
+// boundaries, answered with the point index.  Any disagreement with the
+// same loop without the index, before or after the index is built or the
+// loop is frozen, is an error.
+void BM_LoopContainsCellAlignedPoint(benchmark::State& state) {
+  int const level = 16;
+  std::mt19937_64 rng(12345);
+  S2CellId const corner =
+      S2CellId::FromPoint(kCities[0].ToPoint()).parent(level);
+  scoped_ptr<S2Loop> loop(MakeCellAlignedLoop(corner, 24, 16, 128));
+  std::vector<S2Point> const queries =
+      CellAlignedQueries(loop.get(), level, 4096, &rng);
+  std::vector<bool> expected(queries.size());
+  {
+    ScopedUsePointIndex use_point_index(false);
+    for (size_t k = 0; k < queries.size(); ++k) {
+      expected[k] = loop->Contains(queries[k]);
+    }
+  }
+  ScopedUsePointIndex use_point_index(true);
+  scoped_ptr<S2Loop> frozen(loop->Clone());
+  frozen->Freeze();
+  // "loop" builds its index partway through the first pass.
+  bool agree = true;
+  for (int pass = 0; pass < 2 && agree; ++pass) {
+    for (size_t k = 0; k < queries.size() && agree; ++k) {
+      agree = loop->Contains(queries[k]) == expected[k] &&
+              frozen->Contains(queries[k]) == expected[k];
+    }
+  }
+  if (!agree) {
+    state.SkipWithError("the point index disagrees with the edge crossing "
+                        "test");
+  }
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < queries.size(); ++k) {
+      count += loop->Contains(queries[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_LoopContainsCellAlignedPoint);
+
+// Validating a loop, which checks for duplicate vertices with a hash map
+// and for crossing edges with the (already computed) edge index.  The loop
+// is nearly round, since the long spikes of a jittered loop with this many
+// vertices make the edge index rather than the hash map dominate.  The
+// argument is the number of loop vertices.
+void BM_LoopIsValid(benchmark::State& state) {
+  std::mt19937_64 rng(12345);
+  scoped_ptr<S2Loop> loop(MakeCityLoop(kCities[0].ToPoint(), 5000,
+                                       state.range(0), 1e-5, &rng));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(loop->IsValid());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LoopIsValid)->Arg(4096)->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace s2_benchmark
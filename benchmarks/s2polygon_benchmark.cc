@@ -0,0 +1,305 @@
+// Benchmarks for S2Polygon operations on city-shaped polygons.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "s2cellid.h"
+#include "s2cellunion.h"
+#include "s2edgeutil.h"
+#include "s2latlng.h"
+#include "s2polygon.h"
+#include "s2polygonbuilder.h"
+#include "s2polygonclassifier.h"
+#include "scoped_ptr.h"
+
+namespace s2_benchmark {
+namespace {
+
+// The union of two overlapping polygons whose centers are 3km apart.  The
+// argument is the number of vertices in each polygon.
+void BM_PolygonUnion(benchmark::State& state) {
+  std::mt19937_64 rng(12345);
+  S2Point const a_center = kCities[0].ToPoint();
+  S2Point const b_center =
+      (a_center + MetersToAngle(3000).radians() * S2::Ortho(a_center))
+          .Normalize();
+  scoped_ptr<S2Polygon> a(MakeCityPolygon(a_center, 5000, state.range(0),
+                                          0.3, &rng));
+  scoped_ptr<S2Polygon> b(MakeCityPolygon(b_center, 5000, state.range(0),
+                                          0.3, &rng));
+  for (auto _ : state) {
+    S2Polygon result;
+    result.InitToUnion(a.get(), b.get());
+    benchmark::DoNotOptimize(result.num_loops());
+  }
+}
+BENCHMARK(BM_PolygonUnion)->Arg(64)->Arg(1024);
+
+// The union of many scan-radius circles around random points in a city.
+// The arguments are the number of circles, the method (0 for the serial
+// DestructiveUnion(), 1 and 2 for DestructiveUnionParallel() with
+// PAIR_BY_SIZE and PAIR_BY_HILBERT_ORDER), and the number of threads.
+void BM_DestructiveUnion(benchmark::State& state) {
+  std::mt19937_64 rng(12345);
+  S2Cap const cap = CityCap(0, 1500);
+  std::vector<S2Polygon*> circles;
+  for (int i = 0; i < state.range(0); ++i) {
+    circles.push_back(MakeCityPolygon(RandomPointInCap(cap, &rng), 70, 16,
+                                      0, &rng));
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<S2Polygon*> polygons;
+    for (size_t i = 0; i < circles.size(); ++i) {
+      polygons.push_back(new S2Polygon);
+      polygons.back()->Copy(circles[i]);
+    }
+    state.ResumeTiming();
+    scoped_ptr<S2Polygon> result;
+    if (state.range(1) == 0) {
+      result.reset(S2Polygon::DestructiveUnion(&polygons));
+    } else {
+      result.reset(S2Polygon::DestructiveUnionParallel(
+          &polygons, S2EdgeUtil::kIntersectionTolerance,
+          state.range(1) == 1 ? S2Polygon::PAIR_BY_SIZE
+                              : S2Polygon::PAIR_BY_HILBERT_ORDER,
+          state.range(2)));
+    }
+    benchmark::DoNotOptimize(result->num_loops());
+  }
+  for (size_t i = 0; i < circles.size(); ++i) delete circles[i];
+}
+BENCHMARK(BM_DestructiveUnion)
+    ->Args({256, 0, 1})->Args({256, 1, 1})->Args({256, 2, 1})
+    ->Args({256, 1, 4})->Args({256, 2, 4})
+    ->Args({1024, 0, 1})->Args({1024, 1, 1})->Args({1024, 2, 1})
+    ->Args({1024, 1, 4})->Args({1024, 2, 4})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// 100 disjoint, nearly round loops of 1000 vertices each, 100000 vertices
+// in total.  Consecutive vertices are about 6m apart.
+std::vector<S2Loop*> MakeLoopGrid() {
+  std::mt19937_64 rng(12345);
+  double const spacing = MetersToAngle(2500).radians();
+  std::vector<S2Loop*> loops;
+  for (int i = 0; i < 100; ++i) {
+    S2LatLng const center = S2LatLng::FromRadians(
+        kCities[0].lat().radians() + spacing * (i / 10),
+        kCities[0].lng().radians() + spacing * (i % 10));
+    loops.push_back(MakeCityLoop(center.ToPoint(), 1000, 1000, 1e-3, &rng));
+  }
+  return loops;
+}
+
+// Validating the loops of a polygon, which looks for shared edges with a
+// hash map before testing the loops against each other.
+void BM_PolygonIsValid(benchmark::State& state) {
+  std::vector<S2Loop*> loops = MakeLoopGrid();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(S2Polygon::IsValid(loops));
+  }
+  state.SetItemsProcessed(state.iterations() * 100000);
+  for (size_t i = 0; i < loops.size(); ++i) delete loops[i];
+}
+BENCHMARK(BM_PolygonIsValid)->Unit(benchmark::kMillisecond);
+
+// Building a polygon from the edges of the loops above with
+// S2PolygonBuilder, which assembles the loops with a hash map from vertex to
+// path position.  The argument is the vertex merge radius in meters; when it
+// is positive, the builder also maps every vertex to its merged position.
+void BM_PolygonBuild(benchmark::State& state) {
+  std::vector<S2Loop*> loops = MakeLoopGrid();
+  S2PolygonBuilderOptions options = S2PolygonBuilderOptions::DIRECTED_XOR();
+  options.set_vertex_merge_radius(MetersToAngle(state.range(0)));
+  for (auto _ : state) {
+    S2PolygonBuilder builder(options);
+    for (size_t i = 0; i < loops.size(); ++i) builder.AddLoop(loops[i]);
+    S2Polygon polygon;
+    builder.AssemblePolygon(&polygon, NULL);
+    benchmark::DoNotOptimize(polygon.num_loops());
+  }
+  state.SetItemsProcessed(state.iterations() * 100000);
+  for (size_t i = 0; i < loops.size(); ++i) delete loops[i];
+}
+BENCHMARK(BM_PolygonBuild)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Point queries from several threads against one shared frozen polygon of
+// 8192 vertices, large enough that Contains() uses the edge index.
+void BM_FrozenPolygonContainsPoint(benchmark::State& state) {
+  static S2Polygon* const polygon = [] {
+    std::mt19937_64 rng(12345);
+    S2Polygon* polygon = MakeCityPolygon(kCities[0].ToPoint(), 5000, 8192,
+                                         0.3, &rng);
+    polygon->Freeze();
+    return polygon;
+  }();
+  std::mt19937_64 rng(54321 + state.thread_index());
+  S2Cap const cap = CityCap(0, 5000);
+  std::vector<S2Point> queries;
+  for (int k = 0; k < 256; ++k) {
+    queries.push_back(RandomPointInCap(cap, &rng));
+  }
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < queries.size(); ++k) {
+      count += polygon->Contains(queries[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_FrozenPolygonContainsPoint)->ThreadRange(1, 4)->UseRealTime();
+
+// Random points in a cap somewhat larger than the polygons below, so that
+// roughly half of them are inside.
+std::vector<S2Point> ClassifyQueries() {
+  std::mt19937_64 rng(54321);
+  S2Cap const cap = CityCap(0, 7000);
+  std::vector<S2Point> queries;
+  for (int k = 0; k < 4096; ++k) {
+    queries.push_back(RandomPointInCap(cap, &rng));
+  }
+  return queries;
+}
+
+// The baseline for BM_ClassifyPoints: one S2Polygon::Contains() call per
+// point.  The argument is the number of polygon vertices.
+void BM_PolygonContainsPoints(benchmark::State& state) {
+  std::mt19937_64 rng(12345);
+  scoped_ptr<S2Polygon> polygon(MakeCityPolygon(
+      kCities[0].ToPoint(), 5000, state.range(0), 0.3, &rng));
+  polygon->Freeze();
+  std::vector<S2Point> const queries = ClassifyQueries();
+  for (auto _ : state) {
+    int count = 0;
+    for (size_t k = 0; k < queries.size(); ++k) {
+      count += polygon->Contains(queries[k]);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_PolygonContainsPoints)->Arg(256)->Arg(4096);
+
+// The same points classified with an S2PolygonClassifier.  The arguments
+// are the number of polygon vertices and the classifier's cell level.  The
+// "exact" counter is the fraction of points that needed an exact test.
+void BM_ClassifyPoints(benchmark::State& state) {
+  std::mt19937_64 rng(12345);
+  scoped_ptr<S2Polygon> polygon(MakeCityPolygon(
+      kCities[0].ToPoint(), 5000, state.range(0), 0.3, &rng));
+  S2PolygonClassifier classifier(polygon.get(), state.range(1));
+  std::vector<S2Point> const queries = ClassifyQueries();
+  std::vector<uint64> hits;
+  for (auto _ : state) {
+    classifier.ContainsPoints(&queries[0], queries.size(), &hits);
+    benchmark::DoNotOptimize(hits[0]);
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+  int exact = 0;
+  for (size_t k = 0; k < queries.size(); ++k) {
+    exact += classifier.LocateCell(queries[k]) ==
+             S2PolygonClassifier::BOUNDARY;
+  }
+  state.counters["exact"] = static_cast<double>(exact) / queries.size();
+}
+BENCHMARK(BM_ClassifyPoints)
+    ->Args({256, 14})->Args({256, 16})->Args({256, 18})
+    ->Args({4096, 14})->Args({4096, 16})->Args({4096, 18});
+
+// Building an S2PolygonClassifier for a 4096-vertex polygon.  The argument
+// is the classifier's cell level.
+void BM_ClassifierBuild(benchmark::State& state) {
+  std::mt19937_64 rng(12345);
+  scoped_ptr<S2Polygon> polygon(MakeCityPolygon(
+      kCities[0].ToPoint(), 5000, 4096, 0.3, &rng));
+  for (auto _ : state) {
+    S2PolygonClassifier classifier(polygon.get(), state.range(0));
+    benchmark::DoNotOptimize(classifier.num_boundary_cells());
+  }
+}
+BENCHMARK(BM_ClassifierBuild)->Arg(14)->Arg(16)->Arg(18)
+    ->Unit(benchmark::kMillisecond);
+
+// The level of the cells that the polygons below are made of.
+int const kCellAlignedLevel = 16;
+
+// Polygons whose edges lie on the boundaries of level kCellAlignedLevel
+// cells: a block of cells with many vertices along its sides, and the
+// border of a random union of cells, which has holes and vertices that are
+// shared by several edges.
+std::vector<S2Polygon*> MakeCellAlignedPolygons() {
+  std::mt19937_64 rng(12345);
+  S2CellId const corner =
+      S2CellId::FromPoint(kCities[0].ToPoint()).parent(kCellAlignedLevel);
+  std::vector<S2Polygon*> polygons;
+  std::vector<S2Loop*> loops;
+  loops.push_back(MakeCellAlignedLoop(corner, 24, 16, 128));
+  polygons.push_back(new S2Polygon(&loops));
+
+  int i, j;
+  int const face = corner.ToFaceIJOrientation(&i, &j, NULL);
+  int const size = corner.GetSizeIJ();
+  std::vector<S2CellId> ids;
+  for (int k = 0; k < 40; ++k) {
+    ids.push_back(S2CellId::FromFaceIJ(face, i + size * (rng() % 8),
+                                       j + size * (rng() % 8))
+                  .parent(kCellAlignedLevel));
+  }
+  S2CellUnion cells;
+  cells.Init(ids);
+  polygons.push_back(new S2Polygon);
+  polygons.back()->InitToCellUnionBorder(cells);
+  return polygons;
+}
+
+// Classifying points on and right next to polygon edges that are also cell
+// edges.  Any disagreement with S2Polygon::Contains() is an error.  The
+// argument is the classifier's cell level.
+void BM_ClassifyCellAlignedPoints(benchmark::State& state) {
+  std::vector<S2Polygon*> const polygons = MakeCellAlignedPolygons();
+  std::vector<S2PolygonClassifier*> classifiers;
+  std::vector<std::vector<S2Point> > queries;
+  std::mt19937_64 rng(54321);
+  for (size_t k = 0; k < polygons.size(); ++k) {
+    classifiers.push_back(
+        new S2PolygonClassifier(polygons[k], state.range(0)));
+    queries.push_back(std::vector<S2Point>());
+    for (int l = 0; l < polygons[k]->num_loops(); ++l) {
+      std::vector<S2Point> const points = CellAlignedQueries(
+          polygons[k]->loop(l), kCellAlignedLevel, 4096, &rng);
+      queries[k].insert(queries[k].end(), points.begin(), points.end());
+    }
+    ScopedUsePointIndex use_point_index(false);
+    for (size_t q = 0; q < queries[k].size(); ++q) {
+      if (classifiers[k]->Contains(queries[k][q]) !=
+          polygons[k]->Contains(queries[k][q])) {
+        state.SkipWithError("S2PolygonClassifier disagrees with "
+                            "S2Polygon::Contains()");
+        break;
+      }
+    }
+  }
+  std::vector<uint64> hits;
+  size_t num_queries = 0;
+  for (auto _ : state) {
+    for (size_t k = 0; k < classifiers.size(); ++k) {
+      classifiers[k]->ContainsPoints(&queries[k][0], queries[k].size(),
+                                     &hits);
+      benchmark::DoNotOptimize(hits[0]);
+      num_queries += queries[k].size();
+    }
+  }
+  state.SetItemsProcessed(num_queries);
+  for (size_t k = 0; k < polygons.size(); ++k) {
+    delete classifiers[k];
+    delete polygons[k];
+  }
+}
+BENCHMARK(BM_ClassifyCellAlignedPoints)->Arg(14)->Arg(16)->Arg(19)->Arg(22);
+
+}  // namespace
+}  // namespace s2_benchmark
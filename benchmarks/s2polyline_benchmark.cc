@@ -0,0 +1,73 @@
+// Benchmarks for the per-vertex passes of S2Polyline and S2Loop on
+// city-shaped inputs.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "s1angle.h"
+#include "s2loop.h"
+#include "s2polyline.h"
+#include "scoped_ptr.h"
+
+namespace s2_benchmark {
+namespace {
+
+// A polyline along the boundary of a city-shaped loop with the given number
+// of vertices.
+S2Polyline* MakeCityPolyline(int num_vertices) {
+  std::mt19937_64 rng(12345);
+  scoped_ptr<S2Loop> loop(MakeCityLoop(kCities[0].ToPoint(), 5000,
+                                       num_vertices, 0.3, &rng));
+  std::vector<S2Point> vertices;
+  for (int i = 0; i < loop->num_vertices(); ++i) {
+    vertices.push_back(loop->vertex(i));
+  }
+  return new S2Polyline(vertices);
+}
+
+// The arguments for the benchmarks below are the number of vertices.
+
+void BM_PolylineGetLength(benchmark::State& state) {
+  scoped_ptr<S2Polyline> line(MakeCityPolyline(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(line->GetLength().radians());
+  }
+  state.SetItemsProcessed(state.iterations() * line->num_vertices());
+}
+BENCHMARK(BM_PolylineGetLength)->Arg(256)->Arg(4096)->Arg(65536);
+
+// Projects random points in a cap somewhat larger than the polyline.
+void BM_PolylineProject(benchmark::State& state) {
+  scoped_ptr<S2Polyline> line(MakeCityPolyline(state.range(0)));
+  std::mt19937_64 rng(54321);
+  S2Cap const cap = CityCap(0, 7000);
+  std::vector<S2Point> queries;
+  for (int k = 0; k < 64; ++k) {
+    queries.push_back(RandomPointInCap(cap, &rng));
+  }
+  for (auto _ : state) {
+    int next_vertex = 0;
+    for (size_t k = 0; k < queries.size(); ++k) {
+      benchmark::DoNotOptimize(line->Project(queries[k], &next_vertex));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_PolylineProject)->Arg(256)->Arg(4096)->Arg(65536);
+
+void BM_LoopGetArea(benchmark::State& state) {
+  std::mt19937_64 rng(12345);
+  scoped_ptr<S2Loop> loop(MakeCityLoop(kCities[0].ToPoint(), 5000,
+                                       state.range(0), 0.3, &rng));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(loop->GetArea());
+  }
+  state.SetItemsProcessed(state.iterations() * loop->num_vertices());
+}
+BENCHMARK(BM_LoopGetArea)->Arg(256)->Arg(4096)->Arg(65536);
+
+}  // namespace
+}  // namespace s2_benchmark
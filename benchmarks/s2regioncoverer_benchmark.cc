@@ -0,0 +1,138 @@
+// Benchmarks for S2RegionCoverer on city-scale caps, as requested by the
+// Pokemon Go API (level 15 cells, at most 100 cells).
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "s2cap.h"
+#include "s2coveringcache.h"
+#include "s2regioncoverer.h"
+
+namespace s2_benchmark {
+namespace {
+
+int const kNumCaps = 256;
+
+// Returns caps of the given radius centered at random points around the
+// benchmark cities.
+std::vector<S2Cap> RandomCaps(double radius_meters) {
+  std::mt19937_64 rng(12345);
+  std::vector<S2Point> centers = RandomCityPoints(kNumCaps, 20000, &rng);
+  std::vector<S2Cap> caps;
+  for (size_t k = 0; k < centers.size(); ++k) {
+    caps.push_back(S2Cap::FromAxisAngle(centers[k],
+                                        MetersToAngle(radius_meters)));
+  }
+  return caps;
+}
+
+// The argument is the cap radius in meters.
+void BM_GetCoveringFreeLevels(benchmark::State& state) {
+  std::vector<S2Cap> caps = RandomCaps(state.range(0));
+  S2RegionCoverer coverer;
+  coverer.set_max_cells(8);
+  vector<S2CellId> covering;
+  for (auto _ : state) {
+    for (size_t k = 0; k < caps.size(); ++k) {
+      coverer.GetCovering(caps[k], &covering);
+    }
+    benchmark::DoNotOptimize(covering.data());
+  }
+  state.SetItemsProcessed(state.iterations() * caps.size());
+}
+BENCHMARK(BM_GetCoveringFreeLevels)->Arg(100)->Arg(1500)->Arg(10000);
+
+void BM_GetCoveringFixedLevel(benchmark::State& state) {
+  std::vector<S2Cap> caps = RandomCaps(state.range(0));
+  S2RegionCoverer coverer;
+  coverer.set_min_level(15);
+  coverer.set_max_level(15);
+  coverer.set_max_cells(100);
+  vector<S2CellId> covering;
+  for (auto _ : state) {
+    for (size_t k = 0; k < caps.size(); ++k) {
+      coverer.GetCovering(caps[k], &covering);
+    }
+    benchmark::DoNotOptimize(covering.data());
+  }
+  state.SetItemsProcessed(state.iterations() * caps.size());
+}
+BENCHMARK(BM_GetCoveringFixedLevel)->Arg(100)->Arg(1500)->Arg(10000);
+
+void BM_GetCapCovering(benchmark::State& state) {
+  std::vector<S2Cap> caps = RandomCaps(state.range(0));
+  S2RegionCoverer coverer;
+  coverer.set_min_level(15);
+  coverer.set_max_level(15);
+  coverer.set_max_cells(100);
+  vector<S2CellId> covering, expected;
+  int mismatches = 0;
+  for (size_t k = 0; k < caps.size(); ++k) {
+    coverer.GetCovering(caps[k], &expected);
+    coverer.GetCapCovering(caps[k], &covering);
+    if (covering != expected) ++mismatches;
+  }
+  if (mismatches > 0) {
+    state.SkipWithError("GetCapCovering() disagrees with GetCovering()");
+  }
+  for (auto _ : state) {
+    for (size_t k = 0; k < caps.size(); ++k) {
+      coverer.GetCapCovering(caps[k], &covering);
+    }
+    benchmark::DoNotOptimize(covering.data());
+  }
+  state.SetItemsProcessed(state.iterations() * caps.size());
+}
+BENCHMARK(BM_GetCapCovering)->Arg(100)->Arg(1500)->Arg(10000);
+
+// A client that repeatedly requests the cells around its (barely moving)
+// position, so that almost every lookup hits the cache.
+void BM_CoveringCacheHit(benchmark::State& state) {
+  std::vector<S2Cap> caps = RandomCaps(1500);
+  S2CoveringCache cache(20, 64 << 20);
+  S2RegionCoverer coverer;
+  coverer.set_min_level(15);
+  coverer.set_max_level(15);
+  coverer.set_max_cells(100);
+  for (size_t k = 0; k < caps.size(); ++k) {
+    cache.GetCovering(&coverer, caps[k]);
+  }
+  for (auto _ : state) {
+    for (size_t k = 0; k < caps.size(); ++k) {
+      S2CoveringCache::Covering covering = cache.GetCovering(&coverer,
+                                                             caps[k]);
+      benchmark::DoNotOptimize(covering.get());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * caps.size());
+}
+BENCHMARK(BM_CoveringCacheHit);
+
+// A client walking in a straight line, moving "arg" meters between
+// requests.
+void BM_GetCapCoveringDelta(benchmark::State& state) {
+  double const step = MetersToAngle(state.range(0)).radians();
+  S2Point const start = kCities[0].ToPoint();
+  S2Point const direction = S2::Ortho(start);
+  S1Angle const radius = MetersToAngle(1500);
+  S2RegionCoverer coverer;
+  coverer.set_min_level(15);
+  coverer.set_max_level(15);
+  coverer.set_max_cells(100);
+  vector<S2CellId> previous, covering, added, removed;
+  int k = 0;
+  for (auto _ : state) {
+    double const d = step * (k++ % 10000);
+    S2Point const center = (cos(d) * start + sin(d) * direction).Normalize();
+    coverer.GetCapCoveringDelta(S2Cap::FromAxisAngle(center, radius),
+                                previous, &covering, &added, &removed);
+    previous.swap(covering);
+  }
+}
+BENCHMARK(BM_GetCapCoveringDelta)->Arg(10)->Arg(100);
+
+}  // namespace
+}  // namespace s2_benchmark
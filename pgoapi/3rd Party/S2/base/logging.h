@@ -42,13 +42,15 @@ using std::endl;
 #define DCHECK_GE(val1, val2) CHECK_GE(val1, val2)
 #define DCHECK_GT(val1, val2) CHECK_GT(val1, val2)
 #else
-#define DCHECK(condition) CHECK(false)
-#define DCHECK_EQ(val1, val2) CHECK(false)
-#define DCHECK_NE(val1, val2) CHECK(false)
-#define DCHECK_LE(val1, val2) CHECK(false)
-#define DCHECK_LT(val1, val2) CHECK(false)
-#define DCHECK_GE(val1, val2) CHECK(false)
-#define DCHECK_GT(val1, val2) CHECK(false)
+// The condition is still compiled (so that it stays valid code) but is
+// never evaluated.
+#define DCHECK(condition) while (false) CHECK(condition)
+#define DCHECK_EQ(val1, val2) while (false) CHECK_EQ(val1, val2)
+#define DCHECK_NE(val1, val2) while (false) CHECK_NE(val1, val2)
+#define DCHECK_LE(val1, val2) while (false) CHECK_LE(val1, val2)
+#define DCHECK_LT(val1, val2) while (false) CHECK_LT(val1, val2)
+#define DCHECK_GE(val1, val2) while (false) CHECK_GE(val1, val2)
+#define DCHECK_GT(val1, val2) while (false) CHECK_GT(val1, val2)
 #endif
 
 #define LOG_INFO LogMessage(__FILE__, __LINE__)
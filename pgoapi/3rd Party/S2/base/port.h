@@ -109,15 +109,15 @@ typedef uint16_t u_int16_t;
 #define bswap_32(x) _byteswap_ulong(x)
 #define bswap_64(x) _byteswap_uint64(x)
 
-#else// defined(OS_MACOSX)
+#elif defined(OS_MACOSX) || defined(__APPLE__)
 // Mac OS X / Darwin features
 #include <libkern/OSByteOrder.h>
 #define bswap_16(x) OSSwapInt16(x)
 #define bswap_32(x) OSSwapInt32(x)
 #define bswap_64(x) OSSwapInt64(x)
 
-//#else
-//#include <byteswap.h>
+#else
+#include <byteswap.h>
 #endif
 
 
@@ -655,31 +655,11 @@ bool S2::OrderedCCW(S2Point const& a, S2Point const& b, S2Point const& c,
   return sum >= 2;
 }
 
-// kIJtoPos[orientation][ij] -> pos
-int const S2::kIJtoPos[4][4] = {
-  // (0,0) (0,1) (1,0) (1,1)
-  {     0,    1,    3,    2  },  // canonical order
-  {     0,    3,    1,    2  },  // axes swapped
-  {     2,    3,    1,    0  },  // bits inverted
-  {     2,    1,    3,    0  },  // swapped & inverted
-};
-
-// kPosToIJ[orientation][pos] -> ij
-int const S2::kPosToIJ[4][4] = {
-  // 0  1  2  3
-  {  0, 1, 3, 2 },    // canonical order:    (0,0), (0,1), (1,1), (1,0)
-  {  0, 2, 3, 1 },    // axes swapped:       (0,0), (1,0), (1,1), (0,1)
-  {  3, 2, 0, 1 },    // bits inverted:      (1,1), (1,0), (0,0), (0,1)
-  {  3, 1, 0, 2 },    // swapped & inverted: (1,1), (0,1), (0,0), (1,0)
-};
-
-// kPosToOrientation[pos] -> orientation_modifier
-int const S2::kPosToOrientation[4] = {
-  kSwapMask,
-  0,
-  0,
-  kInvertMask + kSwapMask,
-};
+// The Hilbert curve tables are initialized in s2.h so that they can be used
+// in constant expressions; these are their definitions.
+constexpr int S2::kIJtoPos[4][4];
+constexpr int S2::kPosToIJ[4][4];
+constexpr int S2::kPosToOrientation[4];
 
 // All of the values below were obtained by a combination of hand analysis and
 // Mathematica.  In general, S2_TAN_PROJECTION produces the most uniform
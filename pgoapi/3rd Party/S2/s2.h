@@ -416,7 +416,13 @@ class S2 {
   // Given a cell orientation and the (i,j)-index of a subcell (0=(0,0),
   // 1=(0,1), 2=(1,0), 3=(1,1)), return the order in which this subcell is
   // visited by the Hilbert curve (a position in the range [0..3]).
-  static int const kIJtoPos[4][4];
+  static constexpr int kIJtoPos[4][4] = {
+    // (0,0) (0,1) (1,0) (1,1)
+    {     0,    1,    3,    2  },  // canonical order
+    {     0,    3,    1,    2  },  // axes swapped
+    {     2,    3,    1,    0  },  // bits inverted
+    {     2,    1,    3,    0  },  // swapped & inverted
+  };
 
   // kPosToIJ[orientation][pos] -> ij
   //
@@ -425,7 +431,13 @@ class S2 {
   // inverse of the previous table:
   //
   //   kPosToIJ[r][kIJtoPos[r][ij]] == ij
-  static int const kPosToIJ[4][4];
+  static constexpr int kPosToIJ[4][4] = {
+    // 0  1  2  3
+    {  0, 1, 3, 2 },    // canonical order:    (0,0), (0,1), (1,1), (1,0)
+    {  0, 2, 3, 1 },    // axes swapped:       (0,0), (1,0), (1,1), (0,1)
+    {  3, 2, 0, 1 },    // bits inverted:      (1,1), (1,0), (0,0), (0,1)
+    {  3, 1, 0, 2 },    // swapped & inverted: (1,1), (0,1), (0,0), (1,0)
+  };
 
   // kPosToOrientation[pos] -> orientation_modifier
   //
@@ -433,7 +445,12 @@ class S2 {
   // with the given traversal position [0..3] is related to the orientation
   // of the parent cell.  The modifier should be XOR-ed with the parent
   // orientation to obtain the curve orientation in the child.
-  static int const kPosToOrientation[4];
+  static constexpr int kPosToOrientation[4] = {
+    kSwapMask,
+    0,
+    0,
+    kInvertMask + kSwapMask,
+  };
 
   ////////////////////////// S2Cell Metrics //////////////////////////////
   //
@@ -583,6 +600,10 @@ class S2 {
   // the class definition, even though GCC doesn't enforce it.
   static double const kMaxDetError;
 
+  // The batch EdgeCrosser methods apply the same test as TriageCCW() to
+  // blocks of vertices at once.
+  friend class S2EdgeUtil;
+
   DISALLOW_IMPLICIT_CONSTRUCTORS(S2);  // Contains only static methods.
 };
 
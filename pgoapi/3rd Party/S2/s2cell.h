@@ -52,6 +52,10 @@ class S2Cell : public S2Region {
   S2Point GetVertex(int k) const { return GetVertexRaw(k).Normalize(); }
   S2Point GetVertexRaw(int k) const;
 
+  // Return the lower (k = 0) or upper (k = 1) bound of the cell in
+  // (u,v)-space along axis "d" (0 for u, 1 for v).
+  double GetUVBound(int d, int k) const { return uv_[d][k]; }
+
   // Return the inward-facing normal of the great circle passing through
   // the edge from vertex k to vertex k+1 (mod 4).  The normals returned
   // by GetEdgeRaw are not necessarily unit length.
@@ -2,7 +2,21 @@
 
 #include "s2cellid.h"
 
-#include <pthread.h>
+#if defined __x86_64__ && (defined __GNUC__ || defined __clang__)
+#include <immintrin.h>
+// The x86-64 specific code paths below (the vectorized point projection used
+// by FromLatLngArray() and the BMI2 Hilbert curve conversions) are selected
+// at runtime based on the CPU.  Scalar double arithmetic is done with SSE2
+// on this architecture, so vector instructions round exactly like it.
+#define S2CELLID_X86 1
+#endif
+
+// The vectorized projection hardcodes the quadratic S2::UVtoST(), so with
+// any other projection FromLatLngArray() converts each point with
+// FromLatLng() instead of silently disagreeing with it.
+#if defined S2CELLID_X86 && S2_PROJECTION == S2_QUADRATIC_PROJECTION
+#define S2CELLID_X86_PROJECTION 1
+#endif
 
 #include <algorithm>
 using std::min;
@@ -17,6 +31,7 @@ using std::setprecision;
 using std::vector;
 
 
+#include "commandlineflags.h"
 #include "integral_types.h"
 #include "logging.h"
 #include "strutil.h"
@@ -58,44 +73,233 @@ static int const kLookupBits = 4;
 static int const kSwapMask = 0x01;
 static int const kInvertMask = 0x02;
 
-static uint16 lookup_pos[1 << (2 * kLookupBits + 2)];
-static uint16 lookup_ij[1 << (2 * kLookupBits + 2)];
+static int const kLookupSize = 1 << (2 * kLookupBits + 2);
+
+// The lookup tables are computed at compile time from the tables in S2, so
+// that they are stored as read-only data and need no initialization.  The
+// functions below are constexpr (and therefore written as single return
+// statements) versions of the recursive subdivision that builds them.
+
+// Returns the lookup_pos value for the subcell of a lookup cell with the
+// given (i,j) bits that is reached after "level" subdivision steps, where
+// "pos" and "orientation" are the position and orientation accumulated so
+// far.
+constexpr int LookupPosValue(int i, int j, int level, int pos,
+                             int orientation);
+
+// Descends into the child at position "child_pos" of the current subcell.
+constexpr int LookupPosChild(int i, int j, int level, int pos,
+                             int orientation, int child_pos) {
+  return LookupPosValue(i, j, level + 1, (pos << 2) + child_pos,
+                        orientation ^ S2::kPosToOrientation[child_pos]);
+}
 
-static void InitLookupCell(int level, int i, int j, int orig_orientation,
-                           int pos, int orientation) {
-  if (level == kLookupBits) {
-    int ij = (i << kLookupBits) + j;
-    lookup_pos[(ij << 2) + orig_orientation] = (pos << 2) + orientation;
-    lookup_ij[(pos << 2) + orig_orientation] = (ij << 2) + orientation;
-  } else {
-    level++;
-    i <<= 1;
-    j <<= 1;
-    pos <<= 2;
-    int const* r = S2::kPosToIJ[orientation];
-    InitLookupCell(level, i + (r[0] >> 1), j + (r[0] & 1), orig_orientation,
-                   pos, orientation ^ S2::kPosToOrientation[0]);
-    InitLookupCell(level, i + (r[1] >> 1), j + (r[1] & 1), orig_orientation,
-                   pos + 1, orientation ^ S2::kPosToOrientation[1]);
-    InitLookupCell(level, i + (r[2] >> 1), j + (r[2] & 1), orig_orientation,
-                   pos + 2, orientation ^ S2::kPosToOrientation[2]);
-    InitLookupCell(level, i + (r[3] >> 1), j + (r[3] & 1), orig_orientation,
-                   pos + 3, orientation ^ S2::kPosToOrientation[3]);
-  }
+constexpr int LookupPosValue(int i, int j, int level, int pos,
+                             int orientation) {
+  return level == kLookupBits ? (pos << 2) + orientation :
+      LookupPosChild(i, j, level, pos, orientation,
+                     S2::kIJtoPos[orientation][
+                         (((i >> (kLookupBits - 1 - level)) & 1) << 1) +
+                         ((j >> (kLookupBits - 1 - level)) & 1)]);
+}
+
+// Returns the lookup_ij value for the subcell at the given position after
+// "level" subdivision steps, where "i", "j" and "orientation" are the
+// coordinates and orientation accumulated so far.
+constexpr int LookupIJValue(int pos, int level, int i, int j,
+                            int orientation);
+
+// Descends into the child with (i,j) index "child_ij" of the current
+// subcell, which is at position "child_pos".
+constexpr int LookupIJChild(int pos, int level, int i, int j,
+                            int orientation, int child_pos, int child_ij) {
+  return LookupIJValue(pos, level + 1, (i << 1) + (child_ij >> 1),
+                       (j << 1) + (child_ij & 1),
+                       orientation ^ S2::kPosToOrientation[child_pos]);
+}
+
+constexpr int LookupIJChildAt(int pos, int level, int i, int j,
+                              int orientation, int child_pos) {
+  return LookupIJChild(pos, level, i, j, orientation, child_pos,
+                       S2::kPosToIJ[orientation][child_pos]);
+}
+
+constexpr int LookupIJValue(int pos, int level, int i, int j,
+                            int orientation) {
+  return level == kLookupBits ?
+      (((i << kLookupBits) + j) << 2) + orientation :
+      LookupIJChildAt(pos, level, i, j, orientation,
+                      (pos >> (2 * (kLookupBits - 1 - level))) & 3);
+}
+
+// The table entries for the index "(ij << 2) + orientation" of lookup_pos
+// and "(pos << 2) + orientation" of lookup_ij respectively.
+constexpr uint16 LookupPosEntry(int index) {
+  return LookupPosValue(index >> (kLookupBits + 2),
+                        (index >> 2) & ((1 << kLookupBits) - 1),
+                        0, 0, index & 3);
+}
+
+constexpr uint16 LookupIJEntry(int index) {
+  return LookupIJValue(index >> 2, 0, 0, 0, index & 3);
+}
+
+// A compile-time sequence of integers 0, 1, ..., N-1 (std::index_sequence
+// is not available in C++11).  The sequence is built by doubling so that
+// the template recursion depth is logarithmic.
+template <int... I> struct IntSequence {};
+
+template <typename A, typename B> struct ConcatSequence;
+template <int... A, int... B>
+struct ConcatSequence<IntSequence<A...>, IntSequence<B...> > {
+  typedef IntSequence<A..., (static_cast<int>(sizeof...(A)) + B)...> type;
+};
+
+template <int N> struct MakeIntSequence {
+  typedef typename ConcatSequence<
+      typename MakeIntSequence<N / 2>::type,
+      typename MakeIntSequence<N - N / 2>::type>::type type;
+};
+template <> struct MakeIntSequence<0> { typedef IntSequence<> type; };
+template <> struct MakeIntSequence<1> { typedef IntSequence<0> type; };
+
+struct LookupTable {
+  uint16 values[kLookupSize];
+
+  constexpr uint16 operator[](int index) const { return values[index]; }
+};
+
+template <int... I>
+constexpr LookupTable MakeLookupPos(IntSequence<I...>) {
+  return LookupTable{{ LookupPosEntry(I)... }};
+}
+
+template <int... I>
+constexpr LookupTable MakeLookupIJ(IntSequence<I...>) {
+  return LookupTable{{ LookupIJEntry(I)... }};
+}
+
+static constexpr LookupTable lookup_pos =
+    MakeLookupPos(MakeIntSequence<kLookupSize>::type());
+static constexpr LookupTable lookup_ij =
+    MakeLookupIJ(MakeIntSequence<kLookupSize>::type());
+
+// Returns true if the entries of lookup_pos and lookup_ij in [begin, end)
+// are inverses of each other.  The range is split in half at each step to
+// keep the constexpr recursion shallow.  This only checks that the tables
+// are consistent; BM_HilbertMatchesReference in the benchmarks compares
+// the conversions with tables built by the original runtime subdivision.
+constexpr bool LookupTablesAreInverse(int begin, int end) {
+  return end - begin == 1 ?
+      lookup_ij[(lookup_pos[begin] & ~3) + (begin & 3)] ==
+          (begin & ~3) + (lookup_pos[begin] & 3) :
+      LookupTablesAreInverse(begin, (begin + end) / 2) &&
+          LookupTablesAreInverse((begin + end) / 2, end);
 }
 
-static void Init() {
-  InitLookupCell(0, 0, 0, 0, 0, 0);
-  InitLookupCell(0, 0, 0, kSwapMask, 0, kSwapMask);
-  InitLookupCell(0, 0, 0, kInvertMask, 0, kInvertMask);
-  InitLookupCell(0, 0, 0, kSwapMask|kInvertMask, 0, kSwapMask|kInvertMask);
+static_assert(LookupTablesAreInverse(0, kLookupSize),
+              "lookup_ij must be the inverse of lookup_pos");
+
+DEFINE_bool(s2cellid_use_bmi2, true,
+            "Use BMI2 instructions for Hilbert curve conversions when the "
+            "CPU supports them");
+
+#ifdef S2CELLID_X86
+
+// Returns true if the CPU has BMI2 and executes PDEP/PEXT in hardware.  AMD
+// processors before Zen 3 implement them in microcode, where they are much
+// slower than the lookup tables.
+static bool CpuHasFastBMI2() {
+  static bool const has_fast_bmi2 = __builtin_cpu_supports("bmi2") &&
+                                    !__builtin_cpu_is("znver1") &&
+                                    !__builtin_cpu_is("znver2");
+  return has_fast_bmi2;
+}
+
+inline static bool UseBMI2() {
+  return FLAGS_s2cellid_use_bmi2 && CpuHasFastBMI2();
+}
+
+static uint64 const kEvenBits = GG_ULONGLONG(0x5555555555555555);
+
+// Returns the Hilbert curve position of leaf cell (i,j) on the given face,
+// computed without lookup tables.  The curve orientation at each level is
+// the composition of the transformations (swap and/or invert) applied at
+// all the levels above it, so rather than walking down the levels, the
+// compositions are computed for all levels at once with a parallel prefix
+// scan over the bits of i and j: each round combines spans of levels that
+// are twice as long as in the previous round.  The words A and B encode the
+// composed transformation and C and D the resulting orientation bits.  The
+// position bits are then interleaved with PDEP.  Odd faces start with the
+// kSwapMask orientation, which is equivalent to exchanging i and j.
+__attribute__((target("bmi2")))
+static uint64 FaceIJToPosBMI2(int face, uint32 i, uint32 j) {
+  uint32 const kOnes = ~uint32(0);
+  uint32 x = (face & kSwapMask) ? j : i;
+  uint32 y = (face & kSwapMask) ? i : j;
+  x <<= 32 - S2CellId::kMaxLevel;
+  y <<= 32 - S2CellId::kMaxLevel;
+
+  uint32 A, B, C, D;
+  {
+    uint32 a = x ^ y;
+    uint32 b = kOnes ^ a;
+    uint32 c = kOnes ^ (x | y);
+    uint32 d = x & (y ^ kOnes);
+    A = a | (b >> 1);
+    B = (a >> 1) ^ a;
+    C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+  }
+  for (int shift = 2; shift <= 8; shift *= 2) {
+    uint32 a = A, b = B, c = C, d = D;
+    A = (a & (a >> shift)) ^ (b & (b >> shift));
+    B = (a & (b >> shift)) ^ (b & ((a ^ b) >> shift));
+    C ^= (a & (c >> shift)) ^ (b & (d >> shift));
+    D ^= (b & (c >> shift)) ^ ((a ^ b) & (d >> shift));
+  }
+  {
+    uint32 a = A, b = B, c = C, d = D;
+    C ^= (a & (c >> 16)) ^ (b & (d >> 16));
+    D ^= (b & (c >> 16)) ^ ((a ^ b) & (d >> 16));
+  }
+  uint32 a = C ^ (C >> 1);
+  uint32 b = D ^ (D >> 1);
+  uint32 pos0 = x ^ y;
+  uint32 pos1 = b | (kOnes ^ (pos0 | a));
+  uint64 pos = (_pdep_u64(pos1, kEvenBits) << 1) | _pdep_u64(pos0, kEvenBits);
+  return pos >> (64 - 2 * S2CellId::kMaxLevel);
 }
 
-static pthread_once_t init_once = PTHREAD_ONCE_INIT;
-inline static void MaybeInit() {
-  pthread_once(&init_once, Init);
+// The inverse of FaceIJToPosBMI2().  Decoding is simpler because the
+// orientation change at each level depends only on the two position bits at
+// that level: positions 0 and 3 toggle kSwapMask, and position 3 also
+// toggles kInvertMask.  The orientation at each level is therefore a prefix
+// XOR of those toggles.  Given the orientation, the canonical (i,j) bits of
+// a position are (p1, p1^p0), which are swapped and/or inverted to get the
+// actual bits.  Returns the orientation of the leaf cell.
+__attribute__((target("bmi2")))
+static int PosToIJBMI2(uint64 pos, int orientation, int* pi, int* pj) {
+  uint32 const kMask = (1U << S2CellId::kMaxLevel) - 1;
+  uint32 p1 = static_cast<uint32>(_pext_u64(pos, kEvenBits << 1)) & kMask;
+  uint32 p0 = static_cast<uint32>(_pext_u64(pos, kEvenBits)) & kMask;
+  uint32 swap = ~(p1 ^ p0) & kMask;
+  uint32 invert = p1 & p0;
+  for (int shift = 1; shift < S2CellId::kMaxLevel; shift *= 2) {
+    swap ^= swap >> shift;
+    invert ^= invert >> shift;
+  }
+  // Bit k of "s" and "v" is the orientation before the level at bit k.
+  uint32 s = (swap >> 1) ^ ((orientation & kSwapMask) ? kMask : 0);
+  uint32 v = invert >> 1;
+  uint32 ci = p1, cj = p1 ^ p0;
+  *pi = static_cast<int>((((s & cj) | (~s & ci)) ^ v) & kMask);
+  *pj = static_cast<int>((((s & ci) | (~s & cj)) ^ v) & kMask);
+  return ((orientation ^ swap) & kSwapMask) | ((invert & 1) ? kInvertMask : 0);
 }
 
+#endif  // S2CELLID_X86
+
 int S2CellId::level() const {
   // Fast path for leaf cells.
   if (is_leaf()) return kMaxLevel;
@@ -204,8 +408,12 @@ inline int S2CellId::STtoIJ(double s) {
 
 
 S2CellId S2CellId::FromFaceIJ(int face, int i, int j) {
-  // Initialization if not done yet
-  MaybeInit();
+#ifdef S2CELLID_X86
+  if (UseBMI2()) {
+    return S2CellId((static_cast<uint64>(face) << kPosBits) +
+                    (FaceIJToPosBMI2(face, i, j) << 1) + 1);
+  }
+#endif
 
   // Optimization notes:
   //  - Non-overlapping bit fields can be combined with either "+" or "|".
@@ -263,41 +471,215 @@ S2CellId S2CellId::FromLatLng(S2LatLng const& ll) {
   return FromPoint(ll.ToPoint());
 }
 
-int S2CellId::ToFaceIJOrientation(int* pi, int* pj, int* orientation) const {
-  // Initialization if not done yet
-  MaybeInit();
+#ifdef S2CELLID_X86_PROJECTION
 
+// The following kernels compute the same values as S2::XYZtoFaceUV(),
+// S2::UVtoST() and the rounding step of STtoIJ() for a block of points
+// stored as separate x, y and z arrays, using the same sequence of IEEE
+// operations so that the results are bit-for-bit identical.  The (i,j)
+// values are written before clamping to [0, kMaxSize-1].
+//
+// The face is chosen from the largest absolute component k (ties prefer the
+// later component, like Vector3::LargestAbsComponent()), and is k+3 if that
+// component is negative.  For the positive faces the (u,v) numerators are
+// (y,z), (-x,z) and (-x,-y); the negative faces swap them.
+
+static void ProjectToFaceIJSSE2(double const* px, double const* py,
+                                double const* pz, int n,
+                                int* face, int32* pi, int32* pj) {
+  __m128d const sign = _mm_set1_pd(-0.0);
+  __m128d const zero = _mm_setzero_pd();
+  __m128d const one = _mm_set1_pd(1.0);
+  __m128d const half = _mm_set1_pd(0.5);
+  __m128d const three = _mm_set1_pd(3.0);
+  __m128d const size = _mm_set1_pd(S2CellId::kMaxSize);
+  for (int k = 0; k < n; k += 2) {
+    __m128d x = _mm_loadu_pd(px + k);
+    __m128d y = _mm_loadu_pd(py + k);
+    __m128d z = _mm_loadu_pd(pz + k);
+    __m128d ax = _mm_andnot_pd(sign, x);
+    __m128d ay = _mm_andnot_pd(sign, y);
+    __m128d az = _mm_andnot_pd(sign, z);
+    __m128d gt_xy = _mm_cmpgt_pd(ax, ay);
+    __m128d is_x = _mm_and_pd(gt_xy, _mm_cmpgt_pd(ax, az));
+    __m128d is_y = _mm_andnot_pd(gt_xy, _mm_cmpgt_pd(ay, az));
+    __m128d is_z = _mm_andnot_pd(_mm_or_pd(is_x, is_y),
+                                 _mm_castsi128_pd(_mm_set1_epi32(-1)));
+    __m128d d = _mm_or_pd(_mm_and_pd(is_x, x),
+                          _mm_or_pd(_mm_and_pd(is_y, y),
+                                    _mm_and_pd(is_z, z)));
+    __m128d neg = _mm_cmplt_pd(d, zero);
+    __m128d a = _mm_or_pd(_mm_and_pd(is_x, y),
+                          _mm_andnot_pd(is_x, _mm_xor_pd(sign, x)));
+    __m128d b = _mm_or_pd(_mm_and_pd(is_z, _mm_xor_pd(sign, y)),
+                          _mm_andnot_pd(is_z, z));
+    __m128d nu = _mm_or_pd(_mm_and_pd(neg, b), _mm_andnot_pd(neg, a));
+    __m128d nv = _mm_or_pd(_mm_and_pd(neg, a), _mm_andnot_pd(neg, b));
+    __m128d uv[2] = { _mm_div_pd(nu, d), _mm_div_pd(nv, d) };
+    int32* ij[2] = { pi + k, pj + k };
+    for (int c = 0; c < 2; ++c) {
+      __m128d t = _mm_mul_pd(three, uv[c]);
+      __m128d s_pos = _mm_mul_pd(half, _mm_sqrt_pd(_mm_add_pd(one, t)));
+      __m128d s_neg = _mm_sub_pd(one, _mm_mul_pd(
+          half, _mm_sqrt_pd(_mm_sub_pd(one, t))));
+      __m128d ge = _mm_cmpge_pd(uv[c], zero);
+      __m128d st = _mm_or_pd(_mm_and_pd(ge, s_pos), _mm_andnot_pd(ge, s_neg));
+      __m128i r = _mm_cvtpd_epi32(_mm_sub_pd(_mm_mul_pd(size, st), half));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(ij[c]), r);
+    }
+    int x_bits = _mm_movemask_pd(is_x);
+    int y_bits = _mm_movemask_pd(is_y);
+    int neg_bits = _mm_movemask_pd(neg);
+    for (int l = 0; l < 2; ++l) {
+      face[k + l] = ((x_bits >> l) & 1 ? 0 : (y_bits >> l) & 1 ? 1 : 2) +
+                    3 * ((neg_bits >> l) & 1);
+    }
+  }
+}
+
+__attribute__((target("avx2")))
+static void ProjectToFaceIJAVX2(double const* px, double const* py,
+                                double const* pz, int n,
+                                int* face, int32* pi, int32* pj) {
+  __m256d const sign = _mm256_set1_pd(-0.0);
+  __m256d const zero = _mm256_setzero_pd();
+  __m256d const one = _mm256_set1_pd(1.0);
+  __m256d const half = _mm256_set1_pd(0.5);
+  __m256d const three = _mm256_set1_pd(3.0);
+  __m256d const size = _mm256_set1_pd(S2CellId::kMaxSize);
+  for (int k = 0; k < n; k += 4) {
+    __m256d x = _mm256_loadu_pd(px + k);
+    __m256d y = _mm256_loadu_pd(py + k);
+    __m256d z = _mm256_loadu_pd(pz + k);
+    __m256d ax = _mm256_andnot_pd(sign, x);
+    __m256d ay = _mm256_andnot_pd(sign, y);
+    __m256d az = _mm256_andnot_pd(sign, z);
+    __m256d gt_xy = _mm256_cmp_pd(ax, ay, _CMP_GT_OQ);
+    __m256d is_x = _mm256_and_pd(gt_xy, _mm256_cmp_pd(ax, az, _CMP_GT_OQ));
+    __m256d is_y = _mm256_andnot_pd(gt_xy, _mm256_cmp_pd(ay, az, _CMP_GT_OQ));
+    __m256d is_z = _mm256_andnot_pd(_mm256_or_pd(is_x, is_y),
+                                    _mm256_castsi256_pd(_mm256_set1_epi32(-1)));
+    __m256d d = _mm256_blendv_pd(_mm256_blendv_pd(z, y, is_y), x, is_x);
+    __m256d neg = _mm256_cmp_pd(d, zero, _CMP_LT_OQ);
+    __m256d a = _mm256_blendv_pd(_mm256_xor_pd(sign, x), y, is_x);
+    __m256d b = _mm256_blendv_pd(z, _mm256_xor_pd(sign, y), is_z);
+    __m256d nu = _mm256_blendv_pd(a, b, neg);
+    __m256d nv = _mm256_blendv_pd(b, a, neg);
+    __m256d uv[2] = { _mm256_div_pd(nu, d), _mm256_div_pd(nv, d) };
+    int32* ij[2] = { pi + k, pj + k };
+    for (int c = 0; c < 2; ++c) {
+      __m256d t = _mm256_mul_pd(three, uv[c]);
+      __m256d s_pos = _mm256_mul_pd(half,
+                                    _mm256_sqrt_pd(_mm256_add_pd(one, t)));
+      __m256d s_neg = _mm256_sub_pd(one, _mm256_mul_pd(
+          half, _mm256_sqrt_pd(_mm256_sub_pd(one, t))));
+      __m256d ge = _mm256_cmp_pd(uv[c], zero, _CMP_GE_OQ);
+      __m256d st = _mm256_blendv_pd(s_neg, s_pos, ge);
+      __m128i r = _mm256_cvtpd_epi32(
+          _mm256_sub_pd(_mm256_mul_pd(size, st), half));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(ij[c]), r);
+    }
+    int x_bits = _mm256_movemask_pd(is_x);
+    int y_bits = _mm256_movemask_pd(is_y);
+    int neg_bits = _mm256_movemask_pd(neg);
+    for (int l = 0; l < 4; ++l) {
+      face[k + l] = ((x_bits >> l) & 1 ? 0 : (y_bits >> l) & 1 ? 1 : 2) +
+                    3 * ((neg_bits >> l) & 1);
+    }
+  }
+}
+
+static bool CpuHasAVX2() {
+  static bool const has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+
+#endif  // S2CELLID_X86_PROJECTION
+
+void S2CellId::FromLatLngArray(double const* lat_degrees,
+                               double const* lng_degrees,
+                               size_t n, uint64* out) {
+#ifdef S2CELLID_X86_PROJECTION
+  // Points are converted in fixed-size blocks so that the intermediate
+  // values stay in L1 cache.  A partial last block is padded with a dummy
+  // point so that the kernels always see a whole number of vectors.
+  static int const kBlockSize = 64;
+  double x[kBlockSize], y[kBlockSize], z[kBlockSize];
+  int face[kBlockSize];
+  int32 i[kBlockSize], j[kBlockSize];
+  bool const use_avx2 = CpuHasAVX2();
+  for (size_t start = 0; start < n; start += kBlockSize) {
+    int const count = static_cast<int>(min<size_t>(kBlockSize, n - start));
+    for (int k = 0; k < count; ++k) {
+      S2Point p = S2LatLng::FromDegrees(lat_degrees[start + k],
+                                        lng_degrees[start + k]).ToPoint();
+      x[k] = p[0];
+      y[k] = p[1];
+      z[k] = p[2];
+    }
+    for (int k = count; k < kBlockSize; ++k) {
+      x[k] = 1;
+      y[k] = z[k] = 0;
+    }
+    if (use_avx2) {
+      ProjectToFaceIJAVX2(x, y, z, kBlockSize, face, i, j);
+    } else {
+      ProjectToFaceIJSSE2(x, y, z, kBlockSize, face, i, j);
+    }
+    for (int k = 0; k < count; ++k) {
+      out[start + k] = FromFaceIJ(face[k],
+                                  max(0, min(kMaxSize - 1, i[k])),
+                                  max(0, min(kMaxSize - 1, j[k]))).id();
+    }
+  }
+#else
+  for (size_t k = 0; k < n; ++k) {
+    out[k] = FromLatLng(S2LatLng::FromDegrees(lat_degrees[k],
+                                              lng_degrees[k])).id();
+  }
+#endif
+}
+
+int S2CellId::ToFaceIJOrientation(int* pi, int* pj, int* orientation) const {
   int i = 0, j = 0;
   int face = this->face();
   int bits = (face & kSwapMask);
 
-  // Each iteration maps 8 bits of the Hilbert curve position into
-  // 4 bits of "i" and "j".  The lookup table transforms a key of the
-  // form "ppppppppoo" to a value of the form "iiiijjjjoo", where the
-  // letters [ijpo] represents bits of "i", "j", the Hilbert curve
-  // position, and the Hilbert curve orientation respectively.
-  //
-  // On the first iteration we need to be careful to clear out the bits
-  // representing the cube face.
-#define GET_BITS(k) do { \
-    int const nbits = (k == 7) ? (kMaxLevel - 7 * kLookupBits) : kLookupBits; \
-    bits += (static_cast<int>(id_ >> (k * 2 * kLookupBits + 1)) \
-             & ((1 << (2 * nbits)) - 1)) << 2; \
-    bits = lookup_ij[bits]; \
-    i += (bits >> (kLookupBits + 2)) << (k * kLookupBits); \
-    j += ((bits >> 2) & ((1 << kLookupBits) - 1)) << (k * kLookupBits); \
-    bits &= (kSwapMask | kInvertMask); \
-  } while (0)
-
-  GET_BITS(7);
-  GET_BITS(6);
-  GET_BITS(5);
-  GET_BITS(4);
-  GET_BITS(3);
-  GET_BITS(2);
-  GET_BITS(1);
-  GET_BITS(0);
-#undef GET_BITS
+#ifdef S2CELLID_X86
+  if (UseBMI2()) {
+    bits = PosToIJBMI2(id_ >> 1, bits, &i, &j);
+  } else
+#endif
+  {
+    // Each iteration maps 8 bits of the Hilbert curve position into
+    // 4 bits of "i" and "j".  The lookup table transforms a key of the
+    // form "ppppppppoo" to a value of the form "iiiijjjjoo", where the
+    // letters [ijpo] represents bits of "i", "j", the Hilbert curve
+    // position, and the Hilbert curve orientation respectively.
+    //
+    // On the first iteration we need to be careful to clear out the bits
+    // representing the cube face.
+  #define GET_BITS(k) do { \
+      int const nbits = (k == 7) ? (kMaxLevel - 7 * kLookupBits) \
+                                 : kLookupBits; \
+      bits += (static_cast<int>(id_ >> (k * 2 * kLookupBits + 1)) \
+               & ((1 << (2 * nbits)) - 1)) << 2; \
+      bits = lookup_ij[bits]; \
+      i += (bits >> (kLookupBits + 2)) << (k * kLookupBits); \
+      j += ((bits >> 2) & ((1 << kLookupBits) - 1)) << (k * kLookupBits); \
+      bits &= (kSwapMask | kInvertMask); \
+    } while (0)
+
+    GET_BITS(7);
+    GET_BITS(6);
+    GET_BITS(5);
+    GET_BITS(4);
+    GET_BITS(3);
+    GET_BITS(2);
+    GET_BITS(1);
+    GET_BITS(0);
+  #undef GET_BITS
+  }
 
   *pi = i;
   *pj = j;
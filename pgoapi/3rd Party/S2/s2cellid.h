@@ -88,6 +88,16 @@ class S2CellId {
   // Return the leaf cell containing the given normalized S2LatLng.
   static S2CellId FromLatLng(S2LatLng const& ll);
 
+  // Sets out[k] to FromLatLng(S2LatLng::FromDegrees(lat_degrees[k],
+  // lng_degrees[k])).id() for each k in [0, n).  The results are identical
+  // to the one-at-a-time conversion, but on x86-64 the projection from
+  // points to (face, i, j) coordinates is done with SSE2 or (when the CPU
+  // supports it) AVX2, several points at a time.  The trigonometry is still
+  // done with the standard library so that every bit of the result matches.
+  static void FromLatLngArray(double const* lat_degrees,
+                              double const* lng_degrees,
+                              size_t n, uint64* out);
+
   // Return the direction vector corresponding to the center of the given
   // cell.  The vector returned by ToPointRaw is not necessarily unit length.
   S2Point ToPoint() const { return ToPointRaw().Normalize(); }
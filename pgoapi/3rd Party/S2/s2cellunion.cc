@@ -7,11 +7,19 @@ using std::min;
 using std::max;
 using std::swap;
 using std::reverse;
+using std::copy;
+using std::sort;
+using std::lower_bound;
+
+#include <utility>
+using std::pair;
+using std::make_pair;
 
 #include <vector>
 using std::vector;
 
 
+#include "coder.h"
 #include "integral_types.h"
 #include "logging.h"
 #include "s2.h"
@@ -19,6 +27,7 @@ using std::vector;
 #include "s2cell.h"
 #include "s2cellid.h"
 #include "s2latlngrect.h"
+#include "s2parallel.h"
 
 // Returns true if the vector of cell_ids is sorted.  Used only in
 // DCHECKs.
@@ -31,6 +40,289 @@ extern bool IsSorted(vector<S2CellId> const& cell_ids) {
   return true;
 }
 
+// Inputs smaller than this are sorted with std::sort, since clearing and
+// scanning the radix sort histograms would cost more than sorting.
+static int const kMinRadixSortSize = 2048;
+
+// Normalize() only splits its work across threads when each thread gets at
+// least this many cells.
+static int const kMinCellsPerNormalizeThread = 1 << 16;
+
+// The radix sorts below use 11-bit digits.
+static int const kRadixDigitBits = 11;
+static int const kRadixBuckets = 1 << kRadixDigitBits;
+
+// Each thread keeps the scratch buffer used to sort large inputs, so that
+// repeated normalizations don't allocate it every time.  Buffers larger
+// than this many cells are freed after use rather than kept.
+static int const kMaxRetainedSortBufferSize = 1 << 20;
+
+namespace {
+
+inline uint64 RadixKey(S2CellId const& id) { return id.id(); }
+inline uint64 RadixKey(pair<uint64, int> const& leaf) { return leaf.first; }
+
+// Sorts [begin, end) by RadixKey() using an LSD radix sort, with "scratch"
+// (which must have room for the same number of elements) as temporary
+// storage.  All digit histograms are computed in one pass, and digits that
+// are the same for every element (e.g. the face and high position bits of
+// cells from a single city) are skipped.  Small inputs use std::sort.
+template <class T>
+void RadixSort(T* begin, T* end, T* scratch) {
+  int const n = end - begin;
+  if (n < kMinRadixSortSize) {
+    sort(begin, end);
+    return;
+  }
+  int const kNumDigits = (64 + kRadixDigitBits - 1) / kRadixDigitBits;
+  vector<int> counts(kNumDigits * kRadixBuckets, 0);
+  for (int k = 0; k < n; ++k) {
+    uint64 key = RadixKey(begin[k]);
+    for (int d = 0; d < kNumDigits; ++d) {
+      int digit = (key >> (d * kRadixDigitBits)) & (kRadixBuckets - 1);
+      ++counts[d * kRadixBuckets + digit];
+    }
+  }
+  T* from = begin;
+  T* to = scratch;
+  for (int d = 0; d < kNumDigits; ++d) {
+    int* bucket = &counts[d * kRadixBuckets];
+    int const shift = d * kRadixDigitBits;
+    if (bucket[(RadixKey(from[0]) >> shift) & (kRadixBuckets - 1)] == n) {
+      continue;
+    }
+    int offset = 0;
+    for (int b = 0; b < kRadixBuckets; ++b) {
+      int count = bucket[b];
+      bucket[b] = offset;
+      offset += count;
+    }
+    for (int k = 0; k < n; ++k) {
+      int digit = (RadixKey(from[k]) >> shift) & (kRadixBuckets - 1);
+      to[bucket[digit]++] = from[k];
+    }
+    swap(from, to);
+  }
+  if (from != begin) copy(from, from + n, begin);
+}
+
+// A parallel radix sort of cell ids runs in two phases.  First the ids are
+// partitioned on their most significant varying digit: each thread counts
+// and then scatters its own contiguous chunk of the input.  Then each thread
+// sorts a contiguous group of the resulting buckets with RadixSort().
+struct SortTask {
+  S2CellId* input;
+  S2CellId* output;
+  int shift;               // The position of the partitioning digit.
+
+  // The partitioning phase.
+  int begin, end;          // The chunk of "input" to partition.
+  vector<int> offsets;     // Digit counts, then positions in "output".
+
+  // The sorting phase.
+  vector<pair<int, int> > buckets;  // Ranges of "output" to sort.
+};
+
+void* PartitionCount(void* arg) {
+  SortTask* task = static_cast<SortTask*>(arg);
+  task->offsets.assign(kRadixBuckets, 0);
+  for (int k = task->begin; k < task->end; ++k) {
+    ++task->offsets[(task->input[k].id() >> task->shift) &
+                    (kRadixBuckets - 1)];
+  }
+  return NULL;
+}
+
+void* PartitionScatter(void* arg) {
+  SortTask* task = static_cast<SortTask*>(arg);
+  for (int k = task->begin; k < task->end; ++k) {
+    S2CellId id = task->input[k];
+    task->output[task->offsets[(id.id() >> task->shift) &
+                               (kRadixBuckets - 1)]++] = id;
+  }
+  return NULL;
+}
+
+void* SortBuckets(void* arg) {
+  SortTask* task = static_cast<SortTask*>(arg);
+  for (int b = 0; b < task->buckets.size(); ++b) {
+    int begin = task->buckets[b].first, end = task->buckets[b].second;
+    // The partitioning phase has finished with the input, so the same range
+    // of it can be used as scratch space.
+    RadixSort(task->output + begin, task->output + end, task->input + begin);
+  }
+  return NULL;
+}
+
+// Returns the calling thread's scratch buffer for SortCellIds().
+vector<S2CellId>* ThreadSortBuffer() {
+  static thread_local vector<S2CellId> buffer;
+  return &buffer;
+}
+
+// Frees "buffer" if it is too large to keep for the next sort.
+void TrimSortBuffer(vector<S2CellId>* buffer) {
+  if (buffer->capacity() > static_cast<size_t>(kMaxRetainedSortBufferSize)) {
+    vector<S2CellId>().swap(*buffer);
+  }
+}
+
+// Sorts "cell_ids" in increasing order using up to "num_threads" threads.
+void SortCellIds(vector<S2CellId>* cell_ids, int num_threads) {
+  int const n = cell_ids->size();
+  if (n < kMinRadixSortSize) {
+    sort(cell_ids->begin(), cell_ids->end());
+    return;
+  }
+  // The multithreaded sort leaves its result in the buffer and swaps it into
+  // "cell_ids", so the buffer must have exactly "n" elements.  Afterwards
+  // the buffer holds the previous storage of "cell_ids" for the next sort.
+  vector<S2CellId>& buffer = *ThreadSortBuffer();
+  buffer.resize(n);
+  if (num_threads <= 1) {
+    RadixSort(&(*cell_ids)[0], &(*cell_ids)[0] + n, &buffer[0]);
+    TrimSortBuffer(&buffer);
+    return;
+  }
+
+  // Partition on the most significant digit that is not the same for every
+  // cell id.
+  uint64 min_id = kuint64max, max_id = 0;
+  for (int k = 0; k < n; ++k) {
+    min_id = min(min_id, (*cell_ids)[k].id());
+    max_id = max(max_id, (*cell_ids)[k].id());
+  }
+  if (min_id == max_id) {
+    TrimSortBuffer(&buffer);
+    return;
+  }
+  int const high_bit = 63 - __builtin_clzll(min_id ^ max_id);
+  int const shift = max(0, high_bit + 1 - kRadixDigitBits);
+
+  vector<SortTask> tasks(num_threads);
+  int const chunk = (n + num_threads - 1) / num_threads;
+  for (int t = 0; t < num_threads; ++t) {
+    tasks[t].input = &(*cell_ids)[0];
+    tasks[t].output = &buffer[0];
+    tasks[t].shift = shift;
+    tasks[t].begin = min(n, t * chunk);
+    tasks[t].end = min(n, (t + 1) * chunk);
+  }
+  S2RunTasks(&tasks, PartitionCount);
+
+  // Convert the counts to positions: bucket b of thread t starts after all
+  // smaller buckets, and after bucket b of all previous threads.  At the
+  // same time, divide the buckets into groups of about n / num_threads ids.
+  int offset = 0, group = 0;
+  for (int b = 0; b < kRadixBuckets; ++b) {
+    int const bucket_begin = offset;
+    for (int t = 0; t < num_threads; ++t) {
+      int count = tasks[t].offsets[b];
+      tasks[t].offsets[b] = offset;
+      offset += count;
+    }
+    if (offset == bucket_begin) continue;
+    while (group + 1 < num_threads &&
+           bucket_begin >= (group + 1) * static_cast<int64>(n) / num_threads) {
+      ++group;
+    }
+    tasks[group].buckets.push_back(make_pair(bucket_begin, offset));
+  }
+  S2RunTasks(&tasks, PartitionScatter);
+  S2RunTasks(&tasks, SortBuckets);
+  cell_ids->swap(buffer);
+  TrimSortBuffer(&buffer);
+}
+
+// Normalizes the sorted cell ids [ids, ids + n) in place, as described in
+// S2CellUnion::Normalize(), and returns the number of cells in the result.
+int NormalizeSorted(S2CellId* ids, int n) {
+  // The output is built in place: ids[0, out) holds the cells emitted so
+  // far, and since at most one cell is emitted per input cell the write
+  // position never overtakes the read position.
+  int out = 0;
+  for (int i = 0; i < n; ++i) {
+    S2CellId id = ids[i];
+
+    // Check whether this cell is contained by the previous cell.
+    if (out > 0 && ids[out - 1].contains(id)) continue;
+
+    // Discard any previous cells contained by this cell.
+    while (out > 0 && id.contains(ids[out - 1])) {
+      --out;
+    }
+
+    // Check whether the last 3 elements of the output plus "id" can be
+    // collapsed into a single parent cell.
+    while (out >= 3) {
+      // A necessary (but not sufficient) condition is that the XOR of the
+      // four cells must be zero.  This is also very fast to test.
+      if ((ids[out - 3].id() ^ ids[out - 2].id() ^ ids[out - 1].id())
+          != id.id())
+        break;
+
+      // Now we do a slightly more expensive but exact test.  First, compute a
+      // mask that blocks out the two bits that encode the child position of
+      // "id" with respect to its parent, then check that the other three
+      // children all agree with "mask.
+      uint64 mask = id.lsb() << 1;
+      mask = ~(mask + (mask << 1));
+      uint64 id_masked = (id.id() & mask);
+      if ((ids[out - 3].id() & mask) != id_masked ||
+          (ids[out - 2].id() & mask) != id_masked ||
+          (ids[out - 1].id() & mask) != id_masked ||
+          id.is_face())
+        break;
+
+      // Replace four children by their parent cell.
+      out -= 3;
+      id = id.parent();
+    }
+    ids[out++] = id;
+  }
+  return out;
+}
+
+struct NormalizeTask {
+  S2CellId* ids;
+  int begin, end;
+  int size;         // The number of cells left in [begin, end).
+};
+
+void* NormalizeChunk(void* arg) {
+  NormalizeTask* task = static_cast<NormalizeTask*>(arg);
+  task->size = NormalizeSorted(task->ids + task->begin,
+                               task->end - task->begin);
+  return NULL;
+}
+
+// Like NormalizeSorted(), but uses up to "num_threads" threads.
+int NormalizeSortedInParallel(S2CellId* ids, int n, int num_threads) {
+  // Each thread normalizes a contiguous chunk on its own.  The chunks are
+  // then moved together and normalized once more, which deals with cells
+  // that overlap or can be collapsed across chunk boundaries.  The
+  // normalized form of a set of cells is unique, so the result is the same
+  // as normalizing in one pass; the last pass is cheap since it mostly
+  // copies cells that are already normalized.
+  vector<NormalizeTask> tasks(num_threads);
+  int const chunk = (n + num_threads - 1) / num_threads;
+  for (int t = 0; t < num_threads; ++t) {
+    tasks[t].ids = ids;
+    tasks[t].begin = min(n, t * chunk);
+    tasks[t].end = min(n, (t + 1) * chunk);
+  }
+  S2RunTasks(&tasks, NormalizeChunk);
+  int size = 0;
+  for (int t = 0; t < num_threads; ++t) {
+    S2CellId const* begin = ids + tasks[t].begin;
+    copy(begin, begin + tasks[t].size, ids + size);
+    size += tasks[t].size;
+  }
+  return NormalizeSorted(ids, size);
+}
+
+}  // namespace
+
 void S2CellUnion::Init(vector<S2CellId> const& cell_ids) {
   InitRaw(cell_ids);
   Normalize();
@@ -80,55 +372,26 @@ S2CellUnion* S2CellUnion::Clone() const {
   return copy;
 }
 
-bool S2CellUnion::Normalize() {
+bool S2CellUnion::Normalize(int num_threads) {
   // Optimize the representation by looking for cases where all subcells
   // of a parent cell are present.
+  //
+  // The cells are normalized in place, which lets repeated calls (e.g.
+  // from S2RegionCoverer) reuse the existing storage.  Large inputs are
+  // radix sorted through a temporary buffer of the same size, which each
+  // thread keeps between calls.
 
-  vector<S2CellId> output;
-  output.reserve(cell_ids_.size());
-  sort(cell_ids_.begin(), cell_ids_.end());
-
-  for (int i = 0; i < num_cells(); ++i) {
-    S2CellId id = cell_id(i);
-
-    // Check whether this cell is contained by the previous cell.
-    if (!output.empty() && output.back().contains(id)) continue;
-
-    // Discard any previous cells contained by this cell.
-    while (!output.empty() && id.contains(output.back())) {
-      output.pop_back();
-    }
-
-    // Check whether the last 3 elements of "output" plus "id" can be
-    // collapsed into a single parent cell.
-    while (output.size() >= 3) {
-      // A necessary (but not sufficient) condition is that the XOR of the
-      // four cells must be zero.  This is also very fast to test.
-      if ((output.end()[-3].id() ^ output.end()[-2].id() ^ output.back().id())
-          != id.id())
-        break;
+  int const num_input = num_cells();
+  num_threads = max(1, min(num_threads,
+                           num_input / kMinCellsPerNormalizeThread));
+  SortCellIds(&cell_ids_, num_threads);
+  if (num_input == 0) return false;
 
-      // Now we do a slightly more expensive but exact test.  First, compute a
-      // mask that blocks out the two bits that encode the child position of
-      // "id" with respect to its parent, then check that the other three
-      // children all agree with "mask.
-      uint64 mask = id.lsb() << 1;
-      mask = ~(mask + (mask << 1));
-      uint64 id_masked = (id.id() & mask);
-      if ((output.end()[-3].id() & mask) != id_masked ||
-          (output.end()[-2].id() & mask) != id_masked ||
-          (output.end()[-1].id() & mask) != id_masked ||
-          id.is_face())
-        break;
-
-      // Replace four children by their parent cell.
-      output.erase(output.end() - 3, output.end());
-      id = id.parent();
-    }
-    output.push_back(id);
-  }
-  if (output.size() < num_cells()) {
-    InitRawSwap(&output);
+  int const out = num_threads > 1 ?
+      NormalizeSortedInParallel(&cell_ids_[0], num_input, num_threads) :
+      NormalizeSorted(&cell_ids_[0], num_input);
+  if (out < num_input) {
+    cell_ids_.resize(out);
     return true;
   }
   return false;
@@ -164,14 +427,14 @@ void S2CellUnion::Denormalize(int min_level, int level_mod,
   }
 }
 
-S2Cap S2CellUnion::GetCapBound() const {
+S2Cap S2CellIdsGetCapBound(S2CellId const* cell_ids, int num_cells) {
   // Compute the approximate centroid of the region.  This won't produce the
   // bounding cap of minimal area, but it should be close enough.
-  if (cell_ids_.empty()) return S2Cap::Empty();
+  if (num_cells == 0) return S2Cap::Empty();
   S2Point centroid(0, 0, 0);
-  for (int i = 0; i < num_cells(); ++i) {
-    double area = S2Cell::AverageArea(cell_id(i).level());
-    centroid += area * cell_id(i).ToPoint();
+  for (int i = 0; i < num_cells; ++i) {
+    double area = S2Cell::AverageArea(cell_ids[i].level());
+    centroid += area * cell_ids[i].ToPoint();
   }
   if (centroid == S2Point(0, 0, 0)) {
     centroid = S2Point(1, 0, 0);
@@ -184,22 +447,49 @@ S2Cap S2CellUnion::GetCapBound() const {
   // *not* sufficient to just bound all the cell vertices because the bounding
   // cap may be concave (i.e. cover more than one hemisphere).
   S2Cap cap = S2Cap::FromAxisHeight(centroid, 0);
-  for (int i = 0; i < num_cells(); ++i) {
-    cap.AddCap(S2Cell(cell_id(i)).GetCapBound());
+  for (int i = 0; i < num_cells; ++i) {
+    cap.AddCap(S2Cell(cell_ids[i]).GetCapBound());
   }
   return cap;
 }
 
-S2LatLngRect S2CellUnion::GetRectBound() const {
+S2Cap S2CellUnion::GetCapBound() const {
+  return S2CellIdsGetCapBound(cell_ids_.data(), num_cells());
+}
+
+S2LatLngRect S2CellIdsGetRectBound(S2CellId const* cell_ids, int num_cells) {
   S2LatLngRect bound = S2LatLngRect::Empty();
-  for (int i = 0; i < num_cells(); ++i) {
-    bound = bound.Union(S2Cell(cell_id(i)).GetRectBound());
+  for (int i = 0; i < num_cells; ++i) {
+    bound = bound.Union(S2Cell(cell_ids[i]).GetRectBound());
   }
   return bound;
 }
 
-bool S2CellUnion::Contains(S2CellId const& id) const {
-  // This function requires that Normalize has been called first.
+S2LatLngRect S2CellUnion::GetRectBound() const {
+  return S2CellIdsGetRectBound(cell_ids_.data(), num_cells());
+}
+
+bool S2CellIdsAreNormalized(S2CellId const* cell_ids, int num_cells) {
+  for (int i = 1; i < num_cells; ++i) {
+    if (cell_ids[i - 1].range_max() >= cell_ids[i].range_min()) return false;
+    // Four disjoint cells at the same level with the same parent must be the
+    // four children of that parent, which should have been replaced by it.
+    if (i >= 3 && !cell_ids[i].is_face()) {
+      int level = cell_ids[i].level();
+      if (cell_ids[i - 1].level() == level &&
+          cell_ids[i - 2].level() == level &&
+          cell_ids[i - 3].level() == level &&
+          cell_ids[i - 3].parent() == cell_ids[i].parent()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool S2CellIdsContain(S2CellId const* cell_ids, int num_cells,
+                      S2CellId const& id) {
+  // This function requires that the cell ids are normalized.
   //
   // This is an exact test.  Each cell occupies a linear span of the S2
   // space-filling curve, and the cell id is simply the position at the center
@@ -208,38 +498,110 @@ bool S2CellUnion::Contains(S2CellId const& id) const {
   // surround the given cell id (using binary search).  There is containment
   // if and only if one of these two cell ids contains this cell.
 
-  vector<S2CellId>::const_iterator i =
-    lower_bound(cell_ids_.begin(), cell_ids_.end(), id);
-  if (i != cell_ids_.end() && i->range_min() <= id) return true;
-  return i != cell_ids_.begin() && (--i)->range_max() >= id;
+  S2CellId const* end = cell_ids + num_cells;
+  S2CellId const* i = lower_bound(cell_ids, end, id);
+  if (i != end && i->range_min() <= id) return true;
+  return i != cell_ids && (--i)->range_max() >= id;
+}
+
+bool S2CellUnion::Contains(S2CellId const& id) const {
+  return S2CellIdsContain(cell_ids_.data(), num_cells(), id);
+}
+
+bool S2CellIdsIntersect(S2CellId const* cell_ids, int num_cells,
+                        S2CellId const& id) {
+  // This function requires that the cell ids are normalized.
+  // This is an exact test; see the comments for S2CellIdsContain() above.
+
+  S2CellId const* end = cell_ids + num_cells;
+  S2CellId const* i = lower_bound(cell_ids, end, id);
+  if (i != end && i->range_min() <= id.range_max()) return true;
+  return i != cell_ids && (--i)->range_max() >= id.range_min();
 }
 
 bool S2CellUnion::Intersects(S2CellId const& id) const {
-  // This function requires that Normalize has been called first.
-  // This is an exact test; see the comments for Contains() above.
+  return S2CellIdsIntersect(cell_ids_.data(), num_cells(), id);
+}
 
-  vector<S2CellId>::const_iterator i =
-    lower_bound(cell_ids_.begin(), cell_ids_.end(), id);
-  if (i != cell_ids_.end() && i->range_min() <= id.range_max()) return true;
-  return i != cell_ids_.begin() && (--i)->range_max() >= id.range_min();
+// Given a normalized vector of cell ids (whose ranges are therefore disjoint
+// and sorted), returns the index of the first cell in [lo, hi) whose
+// range_max() is at least "limit", or "hi" if there is none.
+static int LowerBoundRangeMax(vector<S2CellId> const& cell_ids, int lo, int hi,
+                              S2CellId const& limit) {
+  // Every cell at or after lower_bound(limit) ends at or after "limit", and
+  // since the ranges are disjoint, at most one cell before it can do so.
+  // Searching on the ids themselves keeps the inner loop cheap.
+  int i = lower_bound(cell_ids.begin() + lo, cell_ids.begin() + hi, limit) -
+          cell_ids.begin();
+  if (i > lo && cell_ids[i - 1].range_max() >= limit) --i;
+  return i;
+}
+
+// Like LowerBoundRangeMax(cell_ids, begin, cell_ids.size(), limit), but
+// gallops forward from "begin" before binary searching the last step, so it
+// takes O(log d) time where d is the distance moved.  This makes merging two
+// cell unions fast both when they interleave closely and when one of them is
+// much smaller than the other.
+static int SkipToRangeMax(vector<S2CellId> const& cell_ids, int begin,
+                          S2CellId const& limit) {
+  int const n = cell_ids.size();
+  int lo = begin, hi = begin;
+  for (int step = 1; hi < n && cell_ids[hi].range_max() < limit; step *= 2) {
+    lo = hi + 1;
+    hi = begin + step;
+  }
+  return LowerBoundRangeMax(cell_ids, lo, min(hi, n), limit);
 }
 
 bool S2CellUnion::Contains(S2CellUnion const* y) const {
-  // TODO: A divide-and-conquer or alternating-skip-search approach may be
-  // sigificantly faster in both the average and worst case.
+  // This function requires that both cell unions are normalized.
+  //
+  // We walk along both unions in increasing order.  For each cell of "y"
+  // we skip to the first cell of this union that ends at or after it; that
+  // cell must contain it.  All following cells of "y" up to the end of that
+  // cell are then contained too, so we skip past them as well.
 
-  for (int i = 0; i < y->num_cells(); ++i) {
-    if (!Contains(y->cell_id(i))) return false;
+  vector<S2CellId> const& x_ids = cell_ids_;
+  vector<S2CellId> const& y_ids = y->cell_ids_;
+  int const x_size = x_ids.size(), y_size = y_ids.size();
+  if (y_size == 0) return true;
+  int i = LowerBoundRangeMax(x_ids, 0, x_size, y_ids[0].range_min());
+  int j = 0;
+  while (j < y_size) {
+    i = SkipToRangeMax(x_ids, i, y_ids[j].range_min());
+    if (i == x_size) return false;
+    if (x_ids[i].range_min() > y_ids[j].range_min() ||
+        x_ids[i].range_max() < y_ids[j].range_max()) {
+      return false;
+    }
+    j = SkipToRangeMax(y_ids, j + 1, x_ids[i].range_max().next());
   }
   return true;
 }
 
 bool S2CellUnion::Intersects(S2CellUnion const* y) const {
-  // TODO: A divide-and-conquer or alternating-skip-search approach may be
-  // sigificantly faster in both the average and worst case.
+  // This function requires that both cell unions are normalized.
+  //
+  // This is an alternating skip search: whichever current cell ends first
+  // is advanced to the first cell of its union that ends at or after the
+  // start of the other one, until the two current cells overlap.
 
-  for (int i = 0; i < y->num_cells(); ++i) {
-    if (Intersects(y->cell_id(i))) return true;
+  vector<S2CellId> const& x_ids = cell_ids_;
+  vector<S2CellId> const& y_ids = y->cell_ids_;
+  int const x_size = x_ids.size(), y_size = y_ids.size();
+  if (x_size == 0 || y_size == 0) return false;
+  // Position this union with a plain binary search first, since the first
+  // skip is often a long one (e.g. a small covering against a large union).
+  int i = LowerBoundRangeMax(x_ids, 0, x_size, y_ids[0].range_min());
+  int j = 0;
+  while (i < x_size && j < y_size) {
+    if (x_ids[i].range_max() < y_ids[j].range_min()) {
+      i = SkipToRangeMax(x_ids, i + 1, y_ids[j].range_min());
+    } else if (y_ids[j].range_max() < x_ids[i].range_min()) {
+      j = SkipToRangeMax(y_ids, j + 1, x_ids[i].range_min());
+    } else {
+      return true;
+    }
   }
   return false;
 }
@@ -437,6 +799,136 @@ double S2CellUnion::ExactArea() const {
   return area;
 }
 
+static const unsigned char kCurrentEncodingVersionNumber = 1;
+
+// Returns true if cell "b" starts right after cell "a" ends.
+static inline bool Abuts(S2CellId const& a, S2CellId const& b) {
+  return b.range_min().id() == a.range_max().id() + 2;
+}
+
+void S2CellUnion::Encode(Encoder* const encoder) const {
+  // The decoder merges the runs back into the largest cells that tile
+  // them, so the cell count written below is only right for a normalized
+  // union.
+  if (!S2CellIdsAreNormalized(cell_ids_.data(), num_cells())) {
+    S2CellUnion normalized;
+    normalized.Init(cell_ids_);
+    normalized.Encode(encoder);
+    return;
+  }
+
+  // Runs are measured in cells at the finest level present, so that every
+  // cell covers a whole number of units.
+  int level = 0;
+  int num_runs = 0;
+  for (int i = 0; i < num_cells(); ++i) {
+    level = max(level, cell_id(i).level());
+    if (i == 0 || !Abuts(cell_id(i - 1), cell_id(i))) ++num_runs;
+  }
+  int const shift = 2 * (S2CellId::kMaxLevel - level) + 1;
+
+  encoder->Ensure(2 + 2 * Varint::kMax64 * (num_runs + 1));  // sufficient
+  encoder->put8(kCurrentEncodingVersionNumber);
+  encoder->put8(level);
+  encoder->put_varint64(num_cells());
+  encoder->put_varint64(num_runs);
+  uint64 prev_end = 0;
+  for (int i = 0; i < num_cells(); ) {
+    int j = i + 1;
+    while (j < num_cells() && Abuts(cell_id(j - 1), cell_id(j))) ++j;
+    uint64 start = cell_id(i).range_min().id() >> shift;
+    uint64 end = (cell_id(j - 1).range_max().id() >> shift) + 1;
+    encoder->put_varint64(start - prev_end);
+    encoder->put_varint64(end - start - 1);
+    prev_end = end;
+    i = j;
+  }
+  DCHECK_GE(encoder->avail(), 0);
+}
+
+bool S2CellUnion::Decode(Decoder* const decoder) {
+  S2CellUnionDecoder cells;
+  if (!cells.Init(decoder)) return false;
+  cell_ids_.clear();
+  cell_ids_.reserve(cells.num_cells());
+  for (S2CellId id; cells.Next(&id); ) {
+    cell_ids_.push_back(id);
+  }
+  return cells.ok();
+}
+
+S2CellUnionDecoder::S2CellUnionDecoder()
+  : decoder_(NULL), level_(0), shift_(0), limit_(0), pos_(0), end_(0),
+    runs_left_(0), num_cells_(0), cells_left_(0), ok_(false) {
+}
+
+bool S2CellUnionDecoder::Init(Decoder* decoder) {
+  decoder_ = decoder;
+  pos_ = end_ = runs_left_ = 0;
+  num_cells_ = cells_left_ = 0;
+  ok_ = false;
+  if (decoder->avail() < 2) return false;
+  unsigned char version = decoder->get8();
+  if (version > kCurrentEncodingVersionNumber) return false;
+  level_ = decoder->get8();
+  if (level_ > S2CellId::kMaxLevel) return false;
+  uint64 num_cells, num_runs;
+  if (!decoder->get_varint64(&num_cells) ||
+      !decoder->get_varint64(&num_runs)) {
+    return false;
+  }
+  // Every run takes at least two bytes and is tiled by at least one and at
+  // most 6 cells per level (plus up to 5 faces), which bounds the number of
+  // cells before any memory is allocated for them.
+  if (num_runs > decoder->avail() / 2 || num_cells < num_runs ||
+      num_cells > num_runs * 6 * (level_ + 1) || num_cells > kint32max) {
+    return false;
+  }
+  shift_ = 2 * (S2CellId::kMaxLevel - level_) + 1;
+  limit_ = GG_ULONGLONG(6) << (2 * level_);
+  runs_left_ = num_runs;
+  num_cells_ = cells_left_ = num_cells;
+  ok_ = true;
+  return true;
+}
+
+bool S2CellUnionDecoder::NextRun() {
+  if (!ok_) return false;
+  if (cells_left_ == 0) {
+    ok_ = (pos_ == end_ && runs_left_ == 0);
+    pos_ = end_;
+    return false;
+  }
+  if (runs_left_ == 0) {
+    ok_ = false;
+    return false;
+  }
+  // Most runs in a covering are short and close together, so both varints
+  // usually fit in one byte each.
+  uint64 gap, length;
+  unsigned char const* p = decoder_->ptr();
+  if (decoder_->avail() >= 2 && ((p[0] | p[1]) & 0x80) == 0) {
+    gap = p[0];
+    length = p[1];
+    decoder_->skip(2);
+  } else if (!decoder_->get_varint64(&gap) ||
+             !decoder_->get_varint64(&length)) {
+    ok_ = false;
+    return false;
+  }
+  --runs_left_;
+  // Only the first run may start right after the previous one (at the start
+  // of the curve), and no run may extend past the end of the curve.
+  if ((gap == 0 && end_ > 0) || gap >= limit_ - end_ ||
+      length >= limit_ - end_ - gap) {
+    ok_ = false;
+    return false;
+  }
+  pos_ = end_ + gap;
+  end_ = pos_ + length + 1;
+  return true;
+}
+
 bool operator==(S2CellUnion const& x, S2CellUnion const& y) {
   return x.cell_ids() == y.cell_ids();
 }
@@ -452,3 +944,112 @@ bool S2CellUnion::MayIntersect(S2Cell const& cell) const {
 bool S2CellUnion::Contains(S2Point const& p) const {
   return Contains(S2CellId::FromPoint(p));
 }
+
+// Batches smaller than this are not worth splitting across threads.
+static int const kMinQueriesPerThread = 16384;
+
+// Batch queries are only sorted and merged with the cell union when both
+// are at least this large; otherwise each leaf is looked up separately.
+// Unions of fewer than kMinCellsToMergeBatch cells (1MB of cell ids) mostly
+// stay in cache, so binary searching them is cheaper than sorting the
+// batch, and small batches are dominated by the cost of the first search.
+static int const kMinCellsToMergeBatch = 1 << 17;
+static int const kMinQueriesToMergeBatch = 1024;
+
+namespace {
+
+typedef pair<uint64, int> LeafQuery;
+
+// A contiguous chunk of a batch membership query.  "begin" is a multiple
+// of 64, so that chunks set disjoint words of the hit bitmap and can be
+// processed concurrently.
+struct BatchQuery {
+  S2CellUnion const* cell_union;
+  S2Point const* points;     // Either "points" or "leaf_ids" is set.
+  uint64 const* leaf_ids;
+  int begin, end;
+  uint64* hits;
+};
+
+void* RunBatchQuery(void* arg) {
+  BatchQuery const& query = *static_cast<BatchQuery*>(arg);
+  vector<S2CellId> const& cell_ids = query.cell_union->cell_ids();
+  int const num_cells = cell_ids.size();
+
+  if (num_cells < kMinCellsToMergeBatch ||
+      query.end - query.begin < kMinQueriesToMergeBatch) {
+    for (int k = query.begin; k < query.end; ++k) {
+      S2CellId const leaf = query.points ?
+          S2CellId::FromPoint(query.points[k]) : S2CellId(query.leaf_ids[k]);
+      if (query.cell_union->Contains(leaf)) {
+        query.hits[k >> 6] |= GG_ULONGLONG(1) << (k & 63);
+      }
+    }
+    return NULL;
+  }
+
+  // Each leaf id is paired with its position so that hits can be recorded
+  // after sorting.
+  vector<LeafQuery> leaves(query.end - query.begin);
+  for (int k = query.begin; k < query.end; ++k) {
+    uint64 id = query.points ? S2CellId::FromPoint(query.points[k]).id()
+                             : query.leaf_ids[k];
+    leaves[k - query.begin] = make_pair(id, k);
+  }
+  bool sorted = true;
+  for (int k = 1; k < leaves.size() && sorted; ++k) {
+    sorted = leaves[k - 1].first <= leaves[k].first;
+  }
+  if (!sorted) {
+    vector<LeafQuery> scratch(leaves.size());
+    RadixSort(&leaves[0], &leaves[0] + leaves.size(), &scratch[0]);
+  }
+
+  // Walk the sorted leaves and the cell union together.  For each leaf, the
+  // only cell that can contain it is the first one that ends at or after it.
+  int i = 0;
+  for (int k = 0; k < leaves.size(); ++k) {
+    S2CellId const leaf(leaves[k].first);
+    i = SkipToRangeMax(cell_ids, i, leaf);
+    if (i == num_cells) break;
+    if (cell_ids[i].range_min() <= leaf) {
+      int pos = leaves[k].second;
+      query.hits[pos >> 6] |= GG_ULONGLONG(1) << (pos & 63);
+    }
+  }
+  return NULL;
+}
+
+// Runs the given query, splitting it across up to "num_threads" threads.
+void RunBatchQueryInParallel(BatchQuery const& query, int n, int num_threads,
+                             vector<uint64>* hits) {
+  hits->assign((n + 63) >> 6, 0);
+  if (n == 0) return;
+  num_threads = max(1, min(num_threads, n / kMinQueriesPerThread));
+  // Round the chunk size up to a multiple of 64.
+  int const chunk = ((n + num_threads - 1) / num_threads + 63) & ~63;
+  vector<BatchQuery> chunks;
+  for (int begin = 0; begin < n; begin += chunk) {
+    chunks.push_back(query);
+    chunks.back().begin = begin;
+    chunks.back().end = min(n, begin + chunk);
+    chunks.back().hits = &(*hits)[0];
+  }
+  S2RunTasks(&chunks, RunBatchQuery);
+}
+
+}  // namespace
+
+void S2CellUnion::ContainsPoints(S2Point const* points, int n,
+                                 vector<uint64>* hits,
+                                 int num_threads) const {
+  BatchQuery query = { this, points, NULL, 0, n, NULL };
+  RunBatchQueryInParallel(query, n, num_threads, hits);
+}
+
+void S2CellUnion::ContainsLeafCells(uint64 const* leaf_ids, int n,
+                                    vector<uint64>* hits,
+                                    int num_threads) const {
+  BatchQuery query = { this, NULL, leaf_ids, 0, n, NULL };
+  RunBatchQueryInParallel(query, n, num_threads, hits);
+}
@@ -3,6 +3,9 @@
 #ifndef UTIL_GEOMETRY_S2CELLUNION_H_
 #define UTIL_GEOMETRY_S2CELLUNION_H_
 
+#include <algorithm>
+using std::min;
+
 #include <vector>
 using std::vector;
 
@@ -62,7 +65,11 @@ class S2CellUnion : public S2Region {
   //
   // This method *must* be called before doing any calculations on the cell
   // union, such as Intersects() or Contains().
-  bool Normalize();
+  //
+  // Large inputs can be normalized faster by passing "num_threads" > 1, in
+  // which case the sort and the collapsing of child cells are split across
+  // up to that many threads.  The result is the same.
+  bool Normalize(int num_threads = 1);
 
   // Replaces "output" with an expanded version of the cell union where any
   // cells whose level is less than "min_level" or where (level - min_level)
@@ -94,7 +101,10 @@ class S2CellUnion : public S2Region {
   bool Intersects(S2CellId const& id) const;
 
   // Return true if this cell union contain/intersects the given other cell
-  // union.
+  // union.  Both unions are walked in a single merge pass that gallops over
+  // runs of cells that cannot affect the result, so this takes at most
+  // O(m log(n/m)) time for unions of sizes m <= n and stops as soon as the
+  // answer is known.
   bool Contains(S2CellUnion const* y) const;
   bool Intersects(S2CellUnion const* y) const;
 
@@ -186,22 +196,125 @@ class S2CellUnion : public S2Region {
     return Contains(p);  // The same as Contains() below, just virtual.
   }
 
-  virtual void Encode(Encoder* const encoder) const {
-    LOG(FATAL) << "Unimplemented";
-  }
-  virtual bool Decode(Decoder* const decoder) { return false; }
+  // The encoding stores the leaf cell ranges covered by the union rather than
+  // the cell ids themselves: the cells are sorted along the Hilbert curve,
+  // adjacent cells are merged into runs, and each run is written as two
+  // varints, the gap since the previous run and the run length, in units of
+  // cells at the finest level in the union.  Coverings whose cells mostly
+  // abut each other take a byte or two per run instead of 8 bytes per cell.
+  //
+  // A normalized union of disjoint cells is exactly the set of largest cells
+  // that tile these runs, so Decode() always produces a normalized cell
+  // union.  If this union is not normalized, Encode() encodes its normalized
+  // form instead.  Use S2CellUnionDecoder to read the cells one at a time.
+  virtual void Encode(Encoder* const encoder) const;
+  virtual bool Decode(Decoder* const decoder);
 
   // The point 'p' does not need to be normalized.
   // This is a fast operation (logarithmic in the size of the cell union).
   bool Contains(S2Point const& p) const;
 
+  // Batch versions of Contains(S2Point) and Contains(S2CellId) for leaf cell
+  // ids.  Resizes "hits" to (n + 63) / 64 words and sets bit (k % 64) of
+  // (*hits)[k / 64] if the cell union contains the k-th point or leaf cell,
+  // and clears it otherwise.  For large cell unions, which don't fit in
+  // cache, the queries are sorted once (the sort is skipped if they are
+  // already in order) and matched against the cell union in a single merge
+  // pass, which costs much less per query than separate calls to
+  // Contains().  Smaller cell unions are searched once per query.
+  //
+  // If "num_threads" > 1, large batches are split into up to that many
+  // contiguous chunks that are converted, sorted and merged concurrently.
+  void ContainsPoints(S2Point const* points, int n, vector<uint64>* hits,
+                      int num_threads = 1) const;
+  void ContainsLeafCells(uint64 const* leaf_ids, int n, vector<uint64>* hits,
+                         int num_threads = 1) const;
+
  private:
   vector<S2CellId> cell_ids_;
 
   DISALLOW_EVIL_CONSTRUCTORS(S2CellUnion);
 };
 
+// Reads the cells of a cell union written by S2CellUnion::Encode() in
+// increasing order without materializing the union, e.g. to stream a large
+// coverage map into another data structure.
+//
+//   S2CellUnionDecoder cells;
+//   if (!cells.Init(&decoder)) return false;
+//   for (S2CellId id; cells.Next(&id); ) { ... }
+//   if (!cells.ok()) return false;
+class S2CellUnionDecoder {
+ public:
+  S2CellUnionDecoder();
+
+  // Reads the header of an encoded cell union from "decoder", which must
+  // remain valid while cells are being read.  Returns false if the data is
+  // not a valid encoding.
+  bool Init(Decoder* decoder);
+
+  // The number of cells in the encoded cell union.
+  int num_cells() const { return num_cells_; }
+
+  // Sets "id" to the next cell id and returns true, or returns false once
+  // all the cells have been read or if the data turns out to be corrupt.
+  inline bool Next(S2CellId* id);
+
+  // Returns false if corrupt data has been found.  After Next() has returned
+  // false, this is true only if the complete cell union was read.
+  bool ok() const { return ok_; }
+
+ private:
+  // Called by Next() once the current run or the expected number of cells
+  // is exhausted.  Reads the next run into [pos_, end_), or checks that the
+  // data ended where it should.  Returns false if there are no more cells.
+  bool NextRun();
+
+  Decoder* decoder_;
+  int level_;            // The level of the cells used as units.
+  int shift_;            // Converts units to leaf cell ids.
+  uint64 limit_;         // The number of units along the whole curve.
+  uint64 pos_, end_;     // The unread part of the current run, in units.
+  uint64 runs_left_;
+  int num_cells_;
+  int cells_left_;
+  bool ok_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(S2CellUnionDecoder);
+};
+
+inline bool S2CellUnionDecoder::Next(S2CellId* id) {
+  if ((pos_ == end_ || cells_left_ == 0) && !NextRun()) return false;
+  // Emit the largest cell that starts at "pos_" and fits in the run.  A cell
+  // that is k levels above the units spans 4**k units and starts at a
+  // multiple of that, and it can be no larger than a face.
+  int k = min(__builtin_ctzll(pos_ | (GG_ULONGLONG(1) << 63)),
+              63 - __builtin_clzll(end_ - pos_)) >> 1;
+  k = min(k, level_);
+  *id = S2CellId((pos_ << shift_) +
+                 (GG_ULONGLONG(1) << (shift_ - 1 + 2 * k)));
+  pos_ += GG_ULONGLONG(1) << (2 * k);
+  --cells_left_;
+  return true;
+}
+
 // Return true if two cell unions are identical.
 bool operator==(S2CellUnion const& x, S2CellUnion const& y);
 
+// The implementations of the corresponding S2CellUnion methods, for the
+// "num_cells" normalized cell ids starting at "cell_ids".  These are shared
+// by S2CellUnion and S2CellUnionView, which keeps its cell ids in memory
+// that it does not own.
+bool S2CellIdsContain(S2CellId const* cell_ids, int num_cells,
+                      S2CellId const& id);
+bool S2CellIdsIntersect(S2CellId const* cell_ids, int num_cells,
+                        S2CellId const& id);
+S2Cap S2CellIdsGetCapBound(S2CellId const* cell_ids, int num_cells);
+S2LatLngRect S2CellIdsGetRectBound(S2CellId const* cell_ids, int num_cells);
+
+// Returns true if the cell ids are sorted and pairwise disjoint, and no
+// four of them are the children of a common parent, i.e. if Normalize()
+// would leave them unchanged.  The ids themselves are not checked.
+bool S2CellIdsAreNormalized(S2CellId const* cell_ids, int num_cells);
+
 #endif  // UTIL_GEOMETRY_S2CELLUNION_H_
@@ -0,0 +1,98 @@
+#include "s2cellunionindex.h"
+
+#include <stdint.h>
+
+#include "logging.h"
+#include "s2cellunion.h"
+
+// The cache line size assumed when laying out and prefetching the index.
+static size_t const kCacheLineBytes = 64;
+static int const kKeysPerCacheLine = kCacheLineBytes / sizeof(uint64);
+
+// The number of levels between a node and the descendants that share the
+// cache line prefetched when the node is visited.
+static int const kPrefetchLevels = 3;
+
+S2CellUnionIndex::S2CellUnionIndex(S2CellUnion const& cell_union)
+  : num_cells_(cell_union.num_cells()),
+    num_full_levels_(0),
+    range_min_(num_cells_ + 1) {
+  while ((2 << num_full_levels_) - 1 <= num_cells_) ++num_full_levels_;
+
+  // Position 0 is unused, so the array is aligned such that position
+  // kKeysPerCacheLine * k starts a cache line for every k.  The 8
+  // descendants of position k three levels down are then in one line.
+  range_max_storage_.resize(num_cells_ + 1 + kKeysPerCacheLine);
+  uintptr_t const base = reinterpret_cast<uintptr_t>(&range_max_storage_[0]);
+  range_max_ = &range_max_storage_[0] +
+      (-base & (kCacheLineBytes - 1)) / sizeof(uint64);
+  range_max_[0] = 0;
+  range_min_[0] = 0;
+  int used = Fill(cell_union.cell_ids(), 0, 1);
+  DCHECK_EQ(used, num_cells_);
+}
+
+int S2CellUnionIndex::Fill(vector<S2CellId> const& cell_ids, int i, int k) {
+  if (k <= num_cells_) {
+    i = Fill(cell_ids, i, 2 * k);
+    range_max_[k] = cell_ids[i].range_max().id();
+    range_min_[k] = cell_ids[i].range_min().id();
+    ++i;
+    i = Fill(cell_ids, i, 2 * k + 1);
+  }
+  return i;
+}
+
+inline int S2CellUnionIndex::LowerBound(uint64 id) const {
+  // Descend the tree, going right whenever the node ends before "id".  The
+  // sequence of turns is recorded in the low bits of k, so once k is past
+  // the bottom of the tree, the answer is the node where we last went left:
+  // stripping the trailing right turns (one bits) and that left turn
+  // recovers it.  If we never went left, the result is 0.
+  //
+  // The complete levels take a fixed number of steps.  The last, partial
+  // level is handled with a conditional move rather than a loop exit that
+  // depends on the path taken, which would often be mispredicted.
+  //
+  // Each step prefetches the descendants three levels down, except for the
+  // last three levels, whose descendants are past the end of the tree.
+  uint64 const* const range_max = range_max_;
+  unsigned int k = 1;
+  int level = 0;
+  for (; level < num_full_levels_ - kPrefetchLevels; ++level) {
+    __builtin_prefetch(range_max + kKeysPerCacheLine * k);
+    k = 2 * k + (range_max[k] < id);
+  }
+  for (; level < num_full_levels_; ++level) {
+    k = 2 * k + (range_max[k] < id);
+  }
+  bool const in_tree = k <= static_cast<unsigned int>(num_cells_);
+  unsigned int const next = 2 * k + (range_max[in_tree ? k : 0] < id);
+  k = in_tree ? next : k;
+  return k >> (__builtin_ctz(~k) + 1);
+}
+
+bool S2CellUnionIndex::Contains(S2CellId const& id) const {
+  // Since the cells are disjoint and sorted, the only cell that can contain
+  // "id" is the first one that ends at or after its start.
+  int k = LowerBound(id.range_min().id());
+  return k != 0 && range_min_[k] <= id.range_min().id() &&
+         range_max_[k] >= id.range_max().id();
+}
+
+bool S2CellUnionIndex::Intersects(S2CellId const& id) const {
+  int k = LowerBound(id.range_min().id());
+  return k != 0 && range_min_[k] <= id.range_max().id();
+}
+
+bool S2CellUnionIndex::Contains(S2Point const& p) const {
+  uint64 const id = S2CellId::FromPoint(p).id();
+  int k = LowerBound(id);
+  return k != 0 && range_min_[k] <= id;
+}
+
+size_t S2CellUnionIndex::BytesUsed() const {
+  return sizeof(*this) +
+         (range_max_storage_.capacity() + range_min_.capacity()) *
+         sizeof(uint64);
+}
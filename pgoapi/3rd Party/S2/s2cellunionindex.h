@@ -0,0 +1,87 @@
+#ifndef UTIL_GEOMETRY_S2CELLUNIONINDEX_H_
+#define UTIL_GEOMETRY_S2CELLUNIONINDEX_H_
+
+#include <vector>
+using std::vector;
+
+#include "integral_types.h"
+#include "macros.h"
+#include "s2.h"
+#include "s2cellid.h"
+
+class S2CellUnion;
+
+// An S2CellUnionIndex is a frozen, read-only copy of a normalized
+// S2CellUnion that answers point and cell id queries faster than the cell
+// union itself once the union no longer fits in the L1 cache (a few
+// thousand cells and up).
+//
+// S2CellUnion searches its sorted vector of cell ids with a binary search,
+// which touches a different cache line at almost every step and
+// mispredicts about half of its branches.  The index instead stores the
+// cell ranges in Eytzinger (breadth-first binary tree) order: the first
+// levels of the search tree are packed together at the front of the array
+// and stay cached, the descendants a few levels further down share a cache
+// line that is prefetched while the current level is compared, and the
+// search is branch-free with a fixed number of steps for a given index.
+//
+// The index does not refer to the cell union after construction, so later
+// changes to the union are not reflected.  All methods are const and may be
+// called concurrently from any number of threads.  Typical usage:
+//
+// S2CellUnion geofence;
+// geofence.Init(cell_ids);
+// S2CellUnionIndex index(geofence);
+// if (index.Contains(point)) ...
+class S2CellUnionIndex {
+ public:
+  // Builds an index of the given cell union, which must be normalized.
+  explicit S2CellUnionIndex(S2CellUnion const& cell_union);
+
+  int num_cells() const { return num_cells_; }
+
+  // Return true if the indexed cell union contains the given cell id, with
+  // the same semantics as S2CellUnion::Contains(S2CellId).
+  bool Contains(S2CellId const& id) const;
+
+  // Return true if the indexed cell union intersects the given cell id, with
+  // the same semantics as S2CellUnion::Intersects(S2CellId).
+  bool Intersects(S2CellId const& id) const;
+
+  // Return true if the indexed cell union contains the given point, which
+  // does not need to be normalized.
+  bool Contains(S2Point const& p) const;
+
+  // The number of bytes used by the index.
+  size_t BytesUsed() const;
+
+ private:
+  // Fills positions k and below of the tree from "cell_ids" by an in-order
+  // traversal, starting with cell_ids[i].  Returns the index of the next
+  // unused cell id.
+  int Fill(vector<S2CellId> const& cell_ids, int i, int k);
+
+  // Returns the position in the tree of the first cell whose range_max() is
+  // at least "id", or 0 if there is no such cell.
+  int LowerBound(uint64 id) const;
+
+  int num_cells_;
+
+  // The number of complete levels of the tree, i.e. floor(log2(n + 1)).
+  int num_full_levels_;
+
+  // The range_max() and range_min() of each cell, in Eytzinger order.  The
+  // root of the tree is at position 1, and the children of position k are
+  // at 2k and 2k+1.  Only the range_max() values are compared while
+  // searching, so they are kept in their own array to fit twice as many
+  // tree nodes per cache line.  Position 0 is unused.
+  uint64* range_max_;
+  vector<uint64> range_min_;
+
+  // Backing storage for range_max_, which is aligned to a cache line.
+  vector<uint64> range_max_storage_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(S2CellUnionIndex);
+};
+
+#endif  // UTIL_GEOMETRY_S2CELLUNIONINDEX_H_
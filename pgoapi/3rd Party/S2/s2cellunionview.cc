@@ -0,0 +1,104 @@
+#include "s2cellunionview.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+using std::vector;
+
+#include "logging.h"
+#include "s2cap.h"
+#include "s2cell.h"
+#include "s2cellunion.h"
+#include "s2latlngrect.h"
+
+// The view reinterprets the raw 64-bit ids as S2CellIds.
+COMPILE_ASSERT(sizeof(S2CellId) == sizeof(uint64), S2CellId_is_not_64_bits);
+
+S2CellUnionView::S2CellUnionView(uint64 const* cell_ids, int num_cells)
+  : cell_ids_(reinterpret_cast<S2CellId const*>(cell_ids)),
+    num_cells_(num_cells),
+    mapped_(NULL),
+    mapped_bytes_(0) {
+  DCHECK_GE(num_cells, 0);
+}
+
+S2CellUnionView* S2CellUnionView::Map(char const* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size % sizeof(uint64) != 0 ||
+      st.st_size / sizeof(uint64) > static_cast<uint64>(kint32max)) {
+    close(fd);
+    return NULL;
+  }
+  size_t const bytes = st.st_size;
+  void* mapped = NULL;
+  if (bytes > 0) {
+    // The mapping stays valid after the descriptor is closed.
+    mapped = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+      close(fd);
+      return NULL;
+    }
+  }
+  close(fd);
+  S2CellUnionView* view = new S2CellUnionView(
+      static_cast<uint64 const*>(mapped), bytes / sizeof(uint64));
+  view->mapped_ = mapped;
+  view->mapped_bytes_ = bytes;
+  return view;
+}
+
+S2CellUnionView::~S2CellUnionView() {
+  if (mapped_ != NULL) munmap(mapped_, mapped_bytes_);
+}
+
+bool S2CellUnionView::IsValid() const {
+  for (int i = 0; i < num_cells_; ++i) {
+    if (!cell_ids_[i].is_valid()) return false;
+  }
+  return S2CellIdsAreNormalized(cell_ids_, num_cells_);
+}
+
+bool S2CellUnionView::Contains(S2CellId const& id) const {
+  return S2CellIdsContain(cell_ids_, num_cells_, id);
+}
+
+bool S2CellUnionView::Intersects(S2CellId const& id) const {
+  return S2CellIdsIntersect(cell_ids_, num_cells_, id);
+}
+
+bool S2CellUnionView::Contains(S2Point const& p) const {
+  return Contains(S2CellId::FromPoint(p));
+}
+
+S2CellUnionView* S2CellUnionView::Clone() const {
+  return new S2CellUnionView(reinterpret_cast<uint64 const*>(cell_ids_),
+                             num_cells_);
+}
+
+S2Cap S2CellUnionView::GetCapBound() const {
+  return S2CellIdsGetCapBound(cell_ids_, num_cells_);
+}
+
+S2LatLngRect S2CellUnionView::GetRectBound() const {
+  return S2CellIdsGetRectBound(cell_ids_, num_cells_);
+}
+
+bool S2CellUnionView::Contains(S2Cell const& cell) const {
+  return Contains(cell.id());
+}
+
+bool S2CellUnionView::MayIntersect(S2Cell const& cell) const {
+  return Intersects(cell.id());
+}
+
+void S2CellUnionView::Encode(Encoder* const encoder) const {
+  S2CellUnion cell_union;
+  vector<S2CellId> cell_ids(cell_ids_, cell_ids_ + num_cells_);
+  cell_union.InitRawSwap(&cell_ids);
+  cell_union.Encode(encoder);
+}
@@ -0,0 +1,95 @@
+#ifndef UTIL_GEOMETRY_S2CELLUNIONVIEW_H_
+#define UTIL_GEOMETRY_S2CELLUNIONVIEW_H_
+
+#include <stddef.h>
+
+#include "integral_types.h"
+#include "macros.h"
+#include "s2.h"
+#include "s2cellid.h"
+#include "s2region.h"
+
+class S2CellUnion;
+
+// An S2CellUnionView is a read-only cell union whose cell ids live in memory
+// that it does not own, such as a caller-owned buffer or a memory-mapped
+// file.  Nothing is copied or decoded when a view is created, so a large
+// geofence file can be mapped by several processes that then share a single
+// copy of it in the page cache, and the pages are only read as queries touch
+// them.
+//
+// The cell ids must be normalized (see S2CellUnion::Normalize()) and are
+// stored as 64-bit integers in native byte order, i.e. exactly the contents
+// of the cell_ids() vector of a normalized S2CellUnion.  Such a file can be
+// written with
+//
+//   fwrite(&cell_union.cell_ids()[0], sizeof(S2CellId),
+//          cell_union.num_cells(), file);
+//
+// and then shared with
+//
+//   scoped_ptr<S2CellUnionView> geofence(S2CellUnionView::Map(path));
+//   if (geofence.get() && geofence->Contains(point)) ...
+//
+// All methods are const and may be called concurrently from any number of
+// threads.
+class S2CellUnionView : public S2Region {
+ public:
+  // Creates a view of the "num_cells" normalized cell ids starting at
+  // "cell_ids", which must remain valid and unchanged while the view (or
+  // any clone of it) is in use.
+  S2CellUnionView(uint64 const* cell_ids, int num_cells);
+
+  // Maps the given file of cell ids read-only into memory and returns a view
+  // of it that unmaps the file when deleted, or NULL if the file cannot be
+  // mapped or its size is not a multiple of 8 bytes.  The contents are not
+  // checked; call IsValid() on files that might not be normalized.
+  static S2CellUnionView* Map(char const* path);
+
+  virtual ~S2CellUnionView();
+
+  int num_cells() const { return num_cells_; }
+  S2CellId const& cell_id(int i) const { return cell_ids_[i]; }
+
+  // Returns true if the cell ids are valid and normalized.  This reads the
+  // whole view.
+  bool IsValid() const;
+
+  // These methods have the same semantics as the corresponding methods of
+  // S2CellUnion, and are also logarithmic in the number of cells.
+  bool Contains(S2CellId const& id) const;
+  bool Intersects(S2CellId const& id) const;
+  bool Contains(S2Point const& p) const;
+
+  ////////////////////////////////////////////////////////////////////////
+  // S2Region interface (see s2region.h for details):
+
+  // The clone is a view of the same memory, and does not keep a mapped file
+  // mapped; it must not be used after the original view is deleted.
+  virtual S2CellUnionView* Clone() const;
+  virtual S2Cap GetCapBound() const;
+  virtual S2LatLngRect GetRectBound() const;
+  virtual bool Contains(S2Cell const& cell) const;
+  virtual bool MayIntersect(S2Cell const& cell) const;
+  virtual bool VirtualContainsPoint(S2Point const& p) const {
+    return Contains(p);  // The same as Contains() above, just virtual.
+  }
+
+  // Writes the same encoding as S2CellUnion::Encode().  A view cannot own
+  // decoded cells, so Decode() always returns false; decode into an
+  // S2CellUnion instead.
+  virtual void Encode(Encoder* const encoder) const;
+  virtual bool Decode(Decoder* const decoder) { return false; }
+
+ private:
+  S2CellId const* cell_ids_;
+  int num_cells_;
+
+  // The file mapping owned by this view, if any.
+  void* mapped_;
+  size_t mapped_bytes_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(S2CellUnionView);
+};
+
+#endif  // UTIL_GEOMETRY_S2CELLUNIONVIEW_H_
@@ -0,0 +1,147 @@
+#include "s2coveringcache.h"
+
+#include <string.h>
+
+#include "logging.h"
+#include "s2cap.h"
+#include "s2regioncoverer.h"
+
+// An estimate of the per-entry overhead of the list node, hash map node and
+// shared_ptr control block, used when accounting for memory.
+static size_t const kEntryOverhead = 64;
+
+namespace {
+
+// Holds a pthread mutex for the lifetime of the object.
+class MutexLock {
+ public:
+  explicit MutexLock(pthread_mutex_t* mutex) : mutex_(mutex) {
+    pthread_mutex_lock(mutex_);
+  }
+  ~MutexLock() { pthread_mutex_unlock(mutex_); }
+
+ private:
+  pthread_mutex_t* const mutex_;
+  DISALLOW_EVIL_CONSTRUCTORS(MutexLock);
+};
+
+}  // namespace
+
+bool S2CoveringCache::Key::operator==(Key const& other) const {
+  return cell == other.cell && height == other.height &&
+         min_level == other.min_level && max_level == other.max_level &&
+         level_mod == other.level_mod && max_cells == other.max_cells;
+}
+
+size_t S2CoveringCache::KeyHasher::operator()(Key const& key) const {
+  uint64 height_bits;
+  memcpy(&height_bits, &key.height, sizeof(height_bits));
+  uint64 h = key.cell.id();
+  h = h * 31 + height_bits;
+  h = h * 31 + ((key.min_level << 24) ^ (key.max_level << 16) ^
+                (key.level_mod << 12) ^ key.max_cells);
+  return static_cast<size_t>(h >> 32) + static_cast<size_t>(h);
+}
+
+S2CoveringCache::S2CoveringCache(int quantization_level, size_t max_bytes)
+  : quantization_level_(quantization_level),
+    max_bytes_(max_bytes),
+    bytes_used_(0),
+    hits_(0),
+    misses_(0),
+    evictions_(0) {
+  DCHECK_GE(quantization_level, 0);
+  DCHECK_LE(quantization_level, S2CellId::kMaxLevel);
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+S2CoveringCache::~S2CoveringCache() {
+  pthread_mutex_destroy(&mutex_);
+}
+
+S2CoveringCache::Covering S2CoveringCache::GetCovering(
+    S2RegionCoverer* coverer, S2Cap const& cap) {
+  Key key;
+  key.cell = S2CellId::FromPoint(cap.axis()).parent(quantization_level_);
+  key.height = cap.height();
+  key.min_level = coverer->min_level();
+  key.max_level = coverer->max_level();
+  key.level_mod = coverer->level_mod();
+  key.max_cells = coverer->max_cells();
+  {
+    MutexLock lock(&mutex_);
+    EntryMap::iterator it = index_.find(key);
+    if (it != index_.end()) {
+      ++hits_;
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return it->second->covering;
+    }
+    ++misses_;
+  }
+
+  // Compute the covering without holding the lock, so that a miss doesn't
+  // stall threads that would hit.  If another thread computes the same
+  // covering in the meantime, the first one to be inserted wins.
+  vector<S2CellId>* cells = new vector<S2CellId>;
+  S2Cap quantized = S2Cap::FromAxisHeight(key.cell.ToPoint(), key.height);
+  coverer->GetCapCovering(quantized, cells);
+  Covering covering(cells);
+
+  MutexLock lock(&mutex_);
+  EntryMap::iterator it = index_.find(key);
+  if (it != index_.end()) {
+    return it->second->covering;
+  }
+  Entry entry;
+  entry.key = key;
+  entry.covering = covering;
+  entry.bytes = sizeof(Entry) + sizeof(Key) + sizeof(*cells) +
+                cells->capacity() * sizeof(S2CellId) + kEntryOverhead;
+  entries_.push_front(entry);
+  index_[key] = entries_.begin();
+  bytes_used_ += entry.bytes;
+  EvictLocked();
+  return covering;
+}
+
+void S2CoveringCache::EvictLocked() {
+  while (bytes_used_ > max_bytes_ && !entries_.empty()) {
+    Entry const& oldest = entries_.back();
+    bytes_used_ -= oldest.bytes;
+    index_.erase(oldest.key);
+    entries_.pop_back();
+    ++evictions_;
+  }
+}
+
+void S2CoveringCache::Clear() {
+  MutexLock lock(&mutex_);
+  index_.clear();
+  entries_.clear();
+  bytes_used_ = 0;
+}
+
+uint64 S2CoveringCache::hits() const {
+  MutexLock lock(&mutex_);
+  return hits_;
+}
+
+uint64 S2CoveringCache::misses() const {
+  MutexLock lock(&mutex_);
+  return misses_;
+}
+
+uint64 S2CoveringCache::evictions() const {
+  MutexLock lock(&mutex_);
+  return evictions_;
+}
+
+int S2CoveringCache::num_entries() const {
+  MutexLock lock(&mutex_);
+  return index_.size();
+}
+
+size_t S2CoveringCache::bytes_used() const {
+  MutexLock lock(&mutex_);
+  return bytes_used_;
+}
@@ -0,0 +1,125 @@
+#ifndef UTIL_GEOMETRY_S2COVERINGCACHE_H_
+#define UTIL_GEOMETRY_S2COVERINGCACHE_H_
+
+#include <pthread.h>
+
+#include <list>
+using std::list;
+
+#include <memory>
+using std::shared_ptr;
+
+#include <vector>
+using std::vector;
+
+#if defined __GNUC__ || defined __APPLE__
+#include <ext/hash_map>
+#else
+#include <hash_map>
+#endif
+using __gnu_cxx::hash_map;
+
+#include "integral_types.h"
+#include "macros.h"
+#include "s2cellid.h"
+
+class S2Cap;
+class S2RegionCoverer;
+
+// An S2CoveringCache is a bounded, thread-safe LRU cache of cap coverings.
+// It is intended for clients that repeatedly cover caps whose centers differ
+// by only a few meters, e.g. a scanner that requests the cells around its
+// current position every few seconds.
+//
+// The cap center is quantized by snapping it to the center of the cell at
+// quantization_level() that contains it, so every cap whose center falls in
+// the same cell (and that has the same radius and covering parameters)
+// shares a single covering.  The covering is therefore that of a cap whose
+// center may be up to half a quantization cell away from the requested one;
+// choose quantization_level() accordingly (level 20 cells are about 10m
+// across, level 24 cells about 60cm).
+//
+// Coverings are returned as immutable shared vectors, so a cache hit only
+// costs a hash lookup and a reference count increment.  Typical usage:
+//
+// S2CoveringCache cache(20, 1 << 20);
+// S2RegionCoverer coverer;
+// coverer.set_min_level(15);
+// coverer.set_max_level(15);
+// S2CoveringCache::Covering cells = cache.GetCovering(&coverer, cap);
+class S2CoveringCache {
+ public:
+  typedef shared_ptr<vector<S2CellId> const> Covering;
+
+  // Creates a cache that quantizes cap centers to cells at the given level
+  // and evicts the least recently used coverings once the estimated memory
+  // used by the cached entries exceeds "max_bytes".
+  S2CoveringCache(int quantization_level, size_t max_bytes);
+  ~S2CoveringCache();
+
+  int quantization_level() const { return quantization_level_; }
+  size_t max_bytes() const { return max_bytes_; }
+
+  // Return the covering of "cap" (with its center quantized as described
+  // above) using the parameters of "coverer".  On a cache miss the covering
+  // is computed with coverer->GetCapCovering(), which is called without
+  // holding the cache lock; "coverer" must therefore not be shared between
+  // threads.  Any number of threads may call this method concurrently.
+  Covering GetCovering(S2RegionCoverer* coverer, S2Cap const& cap);
+
+  // Removes all cached coverings.  Coverings that have already been returned
+  // remain valid.  The statistics are not reset.
+  void Clear();
+
+  // Statistics.  These are snapshots; other threads may be using the cache.
+  uint64 hits() const;
+  uint64 misses() const;
+  uint64 evictions() const;
+  int num_entries() const;
+  size_t bytes_used() const;
+
+ private:
+  struct Key {
+    S2CellId cell;      // The quantized cap center.
+    double height;      // The cap height (see S2Cap).
+    int min_level;
+    int max_level;
+    int level_mod;
+    int max_cells;
+
+    bool operator==(Key const& other) const;
+  };
+  struct KeyHasher {
+    size_t operator()(Key const& key) const;
+  };
+  struct Entry {
+    Key key;
+    Covering covering;
+    size_t bytes;
+  };
+  typedef list<Entry> EntryList;
+  typedef hash_map<Key, EntryList::iterator, KeyHasher> EntryMap;
+
+  // Evicts least recently used entries until bytes_used_ <= max_bytes_.
+  // Requires that mutex_ is held.
+  void EvictLocked();
+
+  int const quantization_level_;
+  size_t const max_bytes_;
+
+  // Guards all of the fields below.
+  mutable pthread_mutex_t mutex_;
+
+  // Entries ordered from most to least recently used.
+  EntryList entries_;
+  EntryMap index_;
+  size_t bytes_used_;
+
+  uint64 hits_;
+  uint64 misses_;
+  uint64 evictions_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(S2CoveringCache);
+};
+
+#endif  // UTIL_GEOMETRY_S2COVERINGCACHE_H_
@@ -8,8 +8,8 @@
 // intersect q.
 //
 // The idea is roughly that of
-// Each edge is covered by one or several S2 cells, stored in a multimap
-//   cell -> edge*.
+// Each edge is covered by one or several S2 cells, stored as a sorted array
+// of (cell, edge) pairs.
 // To perform a query, you cover the query edge with a set of cells.  For
 // each such cell c, you find all test edges that are in c,in an ancestor of c
 // or in a child of c.
@@ -59,10 +59,6 @@ using std::max;
 using std::swap;
 using std::reverse;
 
-#include <set>
-using std::set;
-using std::multiset;
-
 #include <utility>
 using std::pair;
 using std::make_pair;
@@ -72,6 +68,7 @@ using std::make_pair;
 #include "logging.h"
 #include "s2cell.h"
 #include "s2edgeutil.h"
+#include "s2parallel.h"
 #include "s2polyline.h"
 #include "s2regioncoverer.h"
 
@@ -82,26 +79,95 @@ DEFINE_bool(always_recurse_on_children, false,
             "For testing, it is useful to always recurse to the end.  "
             "You don't want to use this flag anywhere but in tests.");
 
+// Compares the (cell id, edge) pairs of the mapping with cell ids, so that
+// the edges of a cell can be found by binary search.
+struct CellEdgeLess {
+  bool operator()(pair<S2CellId, int> const& x, S2CellId const& y) const {
+    return x.first < y;
+  }
+  bool operator()(S2CellId const& x, pair<S2CellId, int> const& y) const {
+    return x < y.first;
+  }
+};
+
 void S2EdgeIndex::Reset() {
   minimum_s2_level_used_ = S2CellId::kMaxLevel;
   index_computed_ = false;
   query_count_ = 0;
-  mapping_.clear();
+  CellEdgeVector().swap(mapping_);
 }
 
-void S2EdgeIndex::ComputeIndex() {
-  DCHECK(!index_computed_);
-
-  for (int i = 0; i < num_edges(); ++i) {
-    S2Point from, to;
-    vector<S2CellId> cover;
+// Indexes with fewer edges than this per thread are computed on fewer
+// threads.  Covering an edge takes about a microsecond, so this keeps the
+// thread startup cost small in comparison.
+static int const kMinEdgesPerIndexThread = 4096;
+
+int S2EdgeIndex::ComputeCoverings(int begin, int end,
+                                  CellEdgeVector* mapping) const {
+  // Most edges are covered by a single cell, and the rest by four.
+  mapping->reserve(mapping->size() + (end - begin) * 3 / 2);
+  size_t const first = mapping->size();
+  int min_level = S2CellId::kMaxLevel;
+  vector<S2CellId> cover;
+  for (int i = begin; i < end; ++i) {
     int level = GetCovering(*edge_from(i), *edge_to(i),
                             true, &cover);
-    minimum_s2_level_used_ = min(minimum_s2_level_used_, level);
+    min_level = min(min_level, level);
 
     for (vector<S2CellId>::const_iterator it = cover.begin(); it != cover.end();
          ++it) {
-      mapping_.insert(make_pair(*it, i));
+      mapping->push_back(make_pair(*it, i));
+    }
+  }
+  sort(mapping->begin() + first, mapping->end());
+  return min_level;
+}
+
+struct S2EdgeIndex::CoveringTask {
+  S2EdgeIndex const* index;
+  int begin, end;
+  CellEdgeVector mapping;
+  int min_level;
+};
+
+void* S2EdgeIndex::RunCoveringTask(void* arg) {
+  CoveringTask* task = static_cast<CoveringTask*>(arg);
+  task->min_level = task->index->ComputeCoverings(task->begin, task->end,
+                                                  &task->mapping);
+  return NULL;
+}
+
+void S2EdgeIndex::ComputeIndex(int num_threads) {
+  DCHECK(!index_computed_);
+
+  int const n = num_edges();
+  num_threads = max(1, min(num_threads, n / kMinEdgesPerIndexThread));
+  if (num_threads == 1) {
+    int level = ComputeCoverings(0, n, &mapping_);
+    minimum_s2_level_used_ = min(minimum_s2_level_used_, level);
+  } else {
+    // Each thread covers and sorts a contiguous range of edges.  The sorted
+    // ranges are then merged in order, so the result does not depend on the
+    // number of threads.
+    vector<CoveringTask> tasks(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+      tasks[t].index = this;
+      tasks[t].begin = static_cast<int64>(n) * t / num_threads;
+      tasks[t].end = static_cast<int64>(n) * (t + 1) / num_threads;
+    }
+    S2RunTasks(&tasks, RunCoveringTask);
+    size_t total = 0;
+    for (int t = 0; t < num_threads; ++t) total += tasks[t].mapping.size();
+    mapping_.reserve(total);
+    for (int t = 0; t < num_threads; ++t) {
+      size_t const middle = mapping_.size();
+      mapping_.insert(mapping_.end(), tasks[t].mapping.begin(),
+                      tasks[t].mapping.end());
+      CellEdgeVector().swap(tasks[t].mapping);
+      inplace_merge(mapping_.begin(), mapping_.begin() + middle,
+                    mapping_.end());
+      minimum_s2_level_used_ = min(minimum_s2_level_used_,
+                                   tasks[t].min_level);
     }
   }
   index_computed_ = true;
@@ -150,30 +216,31 @@ void S2EdgeIndex::PredictAdditionalCalls(int n) {
 
 void S2EdgeIndex::GetEdgesInParentCells(
     const vector<S2CellId>& cover,
-    const CellEdgeMultimap& mapping,
+    const CellEdgeVector& mapping,
     int minimum_s2_level_used,
     vector<int>* candidate_crossings) {
-  // Find all parent cells of covering cells.
-  set<S2CellId> parent_cells;
+  // Find all parent cells of covering cells.  The covering has at most a few
+  // cells, so sorting a small vector is cheaper than building a set.
+  vector<S2CellId> parent_cells;
   for (vector<S2CellId>::const_iterator it = cover.begin(); it != cover.end();
        ++it) {
     for (int parent_level = it->level() - 1;
          parent_level >= minimum_s2_level_used;
          --parent_level) {
-      if (!parent_cells.insert(it->parent(parent_level)).second) {
-        break;  // cell is already in => parents are too.
-      }
+      parent_cells.push_back(it->parent(parent_level));
     }
   }
-
-  // Put parent cell edge references into result.
-  for (set<S2CellId>::const_iterator it = parent_cells.begin(); it
-      != parent_cells.end(); ++it) {
-    pair<CellEdgeMultimap::const_iterator,
-        CellEdgeMultimap::const_iterator> range =
-        mapping.equal_range(*it);
-    for (CellEdgeMultimap::const_iterator it2 = range.first;
-         it2 != range.second; ++it2) {
+  sort(parent_cells.begin(), parent_cells.end());
+  parent_cells.erase(unique(parent_cells.begin(), parent_cells.end()),
+                     parent_cells.end());
+
+  // Put parent cell edge references into result.  Both the parent cells and
+  // the mapping are sorted, so each search starts where the last one ended.
+  CellEdgeVector::const_iterator it2 = mapping.begin();
+  for (vector<S2CellId>::const_iterator it = parent_cells.begin();
+       it != parent_cells.end(); ++it) {
+    it2 = lower_bound(it2, mapping.end(), *it, CellEdgeLess());
+    for (; it2 != mapping.end() && it2->first == *it; ++it2) {
       candidate_crossings->push_back(it2->second);
     }
   }
@@ -223,9 +290,9 @@ bool S2EdgeIndex::EdgeIntersectsCellBoundary(
 void S2EdgeIndex::GetEdgesInChildrenCells(
     S2Point const& a, S2Point const& b,
     vector<S2CellId>* cover,
-    const CellEdgeMultimap& mapping,
+    const CellEdgeVector& mapping,
     vector<int>* candidate_crossings) {
-  CellEdgeMultimap::const_iterator it, start, end;
+  CellEdgeVector::const_iterator it, start, end;
 
   int num_cells = 0;
 
@@ -235,8 +302,9 @@ void S2EdgeIndex::GetEdgesInChildrenCells(
     S2CellId cell = cover->back();
     cover->pop_back();
     num_cells++;
-    start = mapping.lower_bound(cell.range_min());
-    end = mapping.upper_bound(cell.range_max());
+    start = lower_bound(mapping.begin(), mapping.end(), cell.range_min(),
+                        CellEdgeLess());
+    end = upper_bound(start, mapping.end(), cell.range_max(), CellEdgeLess());
     int num_edges = 0;
     bool rewind = FLAGS_always_recurse_on_children;
     // TODO(user): Maybe distinguish between edges in current cell, that
@@ -258,9 +326,9 @@ void S2EdgeIndex::GetEdgesInChildrenCells(
         candidate_crossings->pop_back();
       }
       // Add cells at this level
-      pair<CellEdgeMultimap::const_iterator,
-           CellEdgeMultimap::const_iterator> eq =
-                                          mapping.equal_range(cell);
+      pair<CellEdgeVector::const_iterator,
+           CellEdgeVector::const_iterator> eq =
+          equal_range(start, end, cell, CellEdgeLess());
       for (it = eq.first; it != eq.second; ++it) {
         candidate_crossings->push_back(it->second);
       }
@@ -5,10 +5,6 @@
 #ifndef UTIL_GEOMETRY_S2EDGEINDEX_H_
 #define UTIL_GEOMETRY_S2EDGEINDEX_H_
 
-#include <map>
-using std::map;
-using std::multimap;
-
 #include <utility>
 using std::pair;
 using std::make_pair;
@@ -136,9 +132,16 @@ class S2EdgeIndex {
   // Empties the index in case it already contained something.
   void Reset();
 
-  // Computes the index if not yet done and tells if the index has
-  // been computed.
-  void ComputeIndex();
+  // Computes the index, which must not have been computed yet, and tells
+  // if the index has been computed.  Call ComputeIndex() directly to build
+  // the index up front (e.g. when loading data) rather than lazily during
+  // the first queries.
+  //
+  // If "num_threads" > 1, the edge coverings of large indexes are computed
+  // on up to that many threads, and the index is the same as when it is
+  // computed on one thread.  The edge_from() and edge_to() methods of the
+  // subclass must then be safe to call concurrently.
+  void ComputeIndex(int num_threads = 1);
   bool IsIndexComputed() const;
 
   // If the index hasn't been computed yet, looks at how much work has
@@ -172,11 +175,20 @@ class S2EdgeIndex {
   void IncrementQueryCount();
 
  private:
-  typedef multimap<S2CellId, int> CellEdgeMultimap;
+  // (cell id, edge index) pairs sorted by cell id and then edge index.
+  typedef vector<pair<S2CellId, int> > CellEdgeVector;
 
   // Inserts the given directed edge into the quad tree.
   void Insert(S2Point const& a, S2Point const& b, int reference);
 
+  // Appends the (cell, edge) pairs covering edges [begin, end) to "mapping",
+  // sorted, and returns the minimum level of the cells used.
+  int ComputeCoverings(int begin, int end, CellEdgeVector* mapping) const;
+
+  // Runs ComputeCoverings() for a CoveringTask on its own thread.
+  struct CoveringTask;
+  static void* RunCoveringTask(void* task);
+
   // Computes a cell covering of an edge.  Returns the level of the s2 cells
   // used in the covering (only one level is ever used for each call).
   //
@@ -190,11 +202,11 @@ class S2EdgeIndex {
                   vector<S2CellId>* result) const;
 
   // Adds to candidate_crossings all the edges present in any ancestor of any
-  // cell of cover, down to minimum_s2_level_used.  The cell->edge map
-  // is in the variable mapping.
+  // cell of cover, down to minimum_s2_level_used.  The cell->edge pairs
+  // are in the variable mapping.
   static void GetEdgesInParentCells(
     const vector<S2CellId>& cover,
-    const CellEdgeMultimap& mapping,
+    const CellEdgeVector& mapping,
     int minimum_s2_level_used,
     vector<int>* candidate_crossings);
 
@@ -210,12 +222,15 @@ class S2EdgeIndex {
   static void GetEdgesInChildrenCells(
     S2Point const& a, S2Point const& b,
     vector<S2CellId>* cover,
-    const CellEdgeMultimap& mapping,
+    const CellEdgeVector& mapping,
     vector<int>* candidate_crossings);
 
   // Maps cell ids to covered edges; has the property that the set of all cell
-  // ids mapping to a particular edge forms a covering of that edge.
-  CellEdgeMultimap mapping_;
+  // ids mapping to a particular edge forms a covering of that edge.  This is
+  // a flat sorted array rather than a multimap, so it is built with a single
+  // sort and the edges of a cell, or of all its descendants, are found by
+  // binary search followed by a sequential scan.
+  CellEdgeVector mapping_;
 
   // No cell strictly below this level appears in mapping_.  Initially leaf
   // level, that's the minimum level at which we will ever look for test edges.
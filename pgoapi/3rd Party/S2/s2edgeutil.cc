@@ -8,8 +8,21 @@ using std::reverse;
 
 #include "s2edgeutil.h"
 
+#if defined __x86_64__ && (defined __GNUC__ || defined __clang__)
+#include <immintrin.h>
+// The AVX2 triage kernel below is selected at runtime based on the CPU.
+// Scalar double arithmetic is done with SSE2 on this architecture, so it
+// computes exactly the same determinants as S2::TriageCCW().
+#define S2EDGEUTIL_X86 1
+#endif
+
+#include "commandlineflags.h"
 #include "logging.h"
 
+DEFINE_bool(s2edgeutil_use_avx2, true,
+            "Use AVX2 instructions for the batch EdgeCrosser methods when the "
+            "CPU supports them");
+
 bool S2EdgeUtil::SimpleCrossing(S2Point const& a, S2Point const& b,
                                 S2Point const& c, S2Point const& d) {
   // We compute SimpleCCW() for triangles ACB, CBD, BDA, and DAC.  All
@@ -400,6 +413,128 @@ int S2EdgeUtil::EdgeCrosser::RobustCrossingInternal(S2Point const* d) {
   return (dac == acb_) ? 1 : -1;
 }
 
+#ifdef S2EDGEUTIL_X86
+
+static bool CpuHasAVX2() {
+  static bool const has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+
+inline static bool UseAVX2() {
+  return FLAGS_s2edgeutil_use_avx2 && CpuHasAVX2();
+}
+
+// The vertices are read as a flat array of coordinates.
+COMPILE_ASSERT(sizeof(S2Point) == 3 * sizeof(double), S2Point_is_not_packed);
+
+// The number of vertices whose orientations are computed at once; the
+// orientations are kept as the bits of a uint64.
+static int const kTriageBlockSize = 64;
+
+// Returns a mask with bit k set for each edge (v[k-1], v[k]), where
+// 0 < k < n <= kTriageBlockSize, that may cross the edge AB whose normal is
+// "a_cross_b".  The other edges have both endpoints strictly on the same
+// side of AB according to S2::TriageCCW(), which is "max_error" away from
+// the determinants it computes; RobustCrossing() returns -1 for them.
+//
+// Four vertices are handled per iteration.  The products and sums are done
+// in the same order as Vector3::DotProd(), and no FMA instructions are
+// used, so the determinants are identical to the scalar ones.
+__attribute__((target("avx2")))
+static uint64 GetUndecidedEdgesAVX2(S2Point const& a_cross_b,
+                                    double max_error,
+                                    S2Point const* v, int n) {
+  DCHECK_LE(n, kTriageBlockSize);
+  __m256d const nx = _mm256_set1_pd(a_cross_b[0]);
+  __m256d const ny = _mm256_set1_pd(a_cross_b[1]);
+  __m256d const nz = _mm256_set1_pd(a_cross_b[2]);
+  __m256d const upper = _mm256_set1_pd(max_error);
+  __m256d const lower = _mm256_set1_pd(-max_error);
+  double const* coords = reinterpret_cast<double const*>(v);
+  uint64 pos = 0, neg = 0;
+  int k = 0;
+  for (; k + 4 <= n; k += 4) {
+    // Transpose four (x, y, z) triples into vectors of x, y, and z.
+    __m256d m0 = _mm256_loadu_pd(coords + 3 * k);      // x0 y0 z0 x1
+    __m256d m1 = _mm256_loadu_pd(coords + 3 * k + 4);  // y1 z1 x2 y2
+    __m256d m2 = _mm256_loadu_pd(coords + 3 * k + 8);  // z2 x3 y3 z3
+    __m256d t0 = _mm256_permute2f128_pd(m0, m2, 0x21);  // z0 x1 z2 x3
+    __m256d t1 = _mm256_permute2f128_pd(m0, m2, 0x30);  // x0 y0 y3 z3
+    __m256d x = _mm256_blend_pd(_mm256_blend_pd(t1, t0, 0xa), m1, 0x4);
+    __m256d y = _mm256_permute_pd(_mm256_blend_pd(t1, m1, 0x9), 0x5);
+    __m256d z = _mm256_blend_pd(_mm256_blend_pd(t0, m1, 0x2), t1, 0x8);
+    __m256d det = _mm256_add_pd(
+        _mm256_add_pd(_mm256_mul_pd(nx, x), _mm256_mul_pd(ny, y)),
+        _mm256_mul_pd(nz, z));
+    pos |= static_cast<uint64>(_mm256_movemask_pd(
+        _mm256_cmp_pd(det, upper, _CMP_GT_OQ))) << k;
+    neg |= static_cast<uint64>(_mm256_movemask_pd(
+        _mm256_cmp_pd(det, lower, _CMP_LT_OQ))) << k;
+  }
+  for (; k < n; ++k) {
+    double det = a_cross_b.DotProd(v[k]);
+    pos |= static_cast<uint64>(det > max_error) << k;
+    neg |= static_cast<uint64>(det < -max_error) << k;
+  }
+  uint64 decided = (pos & (pos << 1)) | (neg & (neg << 1));
+  uint64 edges = (n == kTriageBlockSize ? ~uint64(0)
+                                        : (uint64(1) << n) - 1) & ~uint64(1);
+  return edges & ~decided;
+}
+
+#endif  // S2EDGEUTIL_X86
+
+int S2EdgeUtil::EdgeCrosser::CountEdgeOrVertexCrossings(S2Point const* v,
+                                                        int n) {
+  int count = 0;
+#ifdef S2EDGEUTIL_X86
+  if (UseAVX2() && n > 1) {
+    count += EdgeOrVertexCrossing(&v[0]);
+    // Each block starts at the last vertex of the previous one.
+    for (int start = 0; start < n - 1; start += kTriageBlockSize - 1) {
+      int const size = min(kTriageBlockSize, n - start);
+      for (uint64 edges = GetUndecidedEdgesAVX2(a_cross_b_, S2::kMaxDetError,
+                                                v + start, size);
+           edges != 0; edges &= edges - 1) {
+        int const k = start + __builtin_ctzll(edges);
+        if (c_ != &v[k - 1]) RestartAt(&v[k - 1]);
+        count += EdgeOrVertexCrossing(&v[k]);
+      }
+    }
+    if (c_ != &v[n - 1]) RestartAt(&v[n - 1]);
+    return count;
+  }
+#endif
+  for (int i = 0; i < n; ++i) {
+    count += EdgeOrVertexCrossing(&v[i]);
+  }
+  return count;
+}
+
+int S2EdgeUtil::EdgeCrosser::FindRobustCrossing(S2Point const* v, int n) {
+#ifdef S2EDGEUTIL_X86
+  if (UseAVX2() && n > 1) {
+    if (RobustCrossing(&v[0]) >= 0) return 0;
+    for (int start = 0; start < n - 1; start += kTriageBlockSize - 1) {
+      int const size = min(kTriageBlockSize, n - start);
+      for (uint64 edges = GetUndecidedEdgesAVX2(a_cross_b_, S2::kMaxDetError,
+                                                v + start, size);
+           edges != 0; edges &= edges - 1) {
+        int const k = start + __builtin_ctzll(edges);
+        if (c_ != &v[k - 1]) RestartAt(&v[k - 1]);
+        if (RobustCrossing(&v[k]) >= 0) return k;
+      }
+    }
+    if (c_ != &v[n - 1]) RestartAt(&v[n - 1]);
+    return -1;
+  }
+#endif
+  for (int i = 0; i < n; ++i) {
+    if (RobustCrossing(&v[i]) >= 0) return i;
+  }
+  return -1;
+}
+
 void S2EdgeUtil::RectBounder::AddPoint(S2Point const* b) {
   DCHECK(S2::IsUnitLength(*b));
   S2LatLng b_latlng(*b);
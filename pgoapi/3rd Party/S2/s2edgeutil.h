@@ -41,6 +41,24 @@ class S2EdgeUtil {
     // implement point-in-polygon containment tests.
     inline bool EdgeOrVertexCrossing(S2Point const* d);
 
+    // The methods below continue the chain with the "n" consecutive vertices
+    // v[0], v[1], ..., v[n-1], which must point to fixed storage as above.
+    // They return the same results as calling the corresponding method above
+    // on each vertex in turn.  On CPUs with AVX2 they first compute the
+    // triage orientations of whole blocks of vertices, four at a time, and
+    // rule out every edge whose endpoints are both strictly on the same side
+    // of AB.  Only the remaining edges, usually a handful near AB, are
+    // tested exactly.  Elsewhere they simply test each vertex in turn.
+
+    // Returns the number of vertices v[i] for which EdgeOrVertexCrossing()
+    // would return true.  Afterwards v[n-1] is the next vertex C.
+    int CountEdgeOrVertexCrossings(S2Point const* v, int n);
+
+    // Returns the smallest i such that RobustCrossing(&v[i]) would return
+    // +1 or 0, or -1 if there is none.  Afterwards v[i] (or v[n-1] if there
+    // is none) is the next vertex C.
+    int FindRobustCrossing(S2Point const* v, int n);
+
    private:
     // This function handles the "slow path" of RobustCrossing(), which does
     // not need to be inlined.
@@ -0,0 +1,155 @@
+#ifndef UTIL_GEOMETRY_S2FLATHASHMAP_H_
+#define UTIL_GEOMETRY_S2FLATHASHMAP_H_
+
+#include <utility>
+using std::pair;
+using std::make_pair;
+
+#include <vector>
+using std::vector;
+
+#include "logging.h"
+#include "macros.h"
+#include "s2.h"  // for hash<S2Point>
+
+// An S2FlatHashMap is a hash map that stores its entries directly in a
+// single array ("open addressing") rather than allocating a node for each
+// entry like hash_map and map do.  Collisions are resolved by linear
+// probing, and erased entries are filled by shifting later entries of the
+// same probe sequence back, so lookups never need to skip deleted slots.
+//
+// This makes inserting and looking up small keys such as S2Points much
+// faster than with hash_map, which matters for the vertex and edge maps
+// that S2Loop, S2Polygon, and S2PolygonBuilder build over every vertex of
+// their input.  The price is that pointers to values are invalidated by
+// any insertion or erasure, and that there is no iteration.
+//
+// "Key" must be default constructible, assignable, and comparable with ==,
+// and "Hasher" must hash keys that compare equal to the same value.  The
+// default Hasher is the hash<S2Point> mix defined in s2.cc.
+template <class Key, class Value, class Hasher = __gnu_cxx::hash<Key> >
+class S2FlatHashMap {
+ public:
+  S2FlatHashMap() : size_(0), mask_(0) {}
+
+  int size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Removes all entries and releases the memory used by the map.
+  void Clear() {
+    vector<Slot>().swap(slots_);
+    size_ = 0;
+    mask_ = 0;
+  }
+
+  // Makes room for "n" entries in total without further allocation.
+  void Reserve(int n) {
+    size_t capacity = kMinCapacity;
+    while (capacity * kMaxLoadNumerator < n * kMaxLoadDenominator) {
+      capacity *= 2;
+    }
+    if (capacity > slots_.size()) Rehash(capacity);
+  }
+
+  // Returns a pointer to the value for "key", or NULL if "key" is not
+  // present.
+  Value const* Find(Key const& key) const {
+    if (slots_.empty()) return NULL;
+    size_t i = hasher_(key) & mask_;
+    for (; slots_[i].full; i = (i + 1) & mask_) {
+      if (slots_[i].key == key) return &slots_[i].value;
+    }
+    return NULL;
+  }
+  Value* Find(Key const& key) {
+    return const_cast<Value*>(
+        static_cast<S2FlatHashMap const*>(this)->Find(key));
+  }
+
+  // If "key" is not present, adds it with the given value.  Returns a
+  // pointer to the value stored for "key" and whether it was added, like
+  // hash_map::insert().
+  pair<Value*, bool> Insert(Key const& key, Value const& value) {
+    if ((size_ + 1) * kMaxLoadDenominator >
+        slots_.size() * kMaxLoadNumerator) {
+      size_t capacity = kMinCapacity;
+      if (!slots_.empty()) capacity = 2 * slots_.size();
+      Rehash(capacity);
+    }
+    size_t i = hasher_(key) & mask_;
+    for (; slots_[i].full; i = (i + 1) & mask_) {
+      if (slots_[i].key == key) return make_pair(&slots_[i].value, false);
+    }
+    Slot* slot = &slots_[i];
+    slot->key = key;
+    slot->value = value;
+    slot->full = true;
+    ++size_;
+    return make_pair(&slot->value, true);
+  }
+
+  // Sets the value for "key", replacing any existing value.
+  void Set(Key const& key, Value const& value) {
+    pair<Value*, bool> result = Insert(key, value);
+    if (!result.second) *result.first = value;
+  }
+
+  // Removes "key" from the map.  Returns false if it was not present.
+  bool Erase(Key const& key) {
+    if (slots_.empty()) return false;
+    size_t i = hasher_(key) & mask_;
+    for (; slots_[i].full; i = (i + 1) & mask_) {
+      if (slots_[i].key == key) break;
+    }
+    if (!slots_[i].full) return false;
+
+    // Move back any later entries of the same probe run whose probe
+    // sequence passes through the emptied slot "i".
+    for (size_t j = (i + 1) & mask_; slots_[j].full; j = (j + 1) & mask_) {
+      size_t home = hasher_(slots_[j].key) & mask_;
+      if (((j - home) & mask_) >= ((j - i) & mask_)) {
+        slots_[i] = slots_[j];
+        i = j;
+      }
+    }
+    slots_[i].full = false;
+    --size_;
+    return true;
+  }
+
+ private:
+  struct Slot {
+    Slot() : full(false) {}
+    Key key;
+    Value value;
+    bool full;
+  };
+
+  // The capacity is a power of two, and the map grows once it is more than
+  // 3/4 full.  Linear probing stays fast up to about that load.
+  static size_t const kMinCapacity = 8;
+  static size_t const kMaxLoadNumerator = 3;
+  static size_t const kMaxLoadDenominator = 4;
+
+  void Rehash(size_t capacity) {
+    DCHECK((capacity & (capacity - 1)) == 0);
+    vector<Slot> old(capacity);
+    old.swap(slots_);
+    mask_ = capacity - 1;
+    for (size_t k = 0; k < old.size(); ++k) {
+      if (!old[k].full) continue;
+      size_t i = hasher_(old[k].key) & mask_;
+      while (slots_[i].full) i = (i + 1) & mask_;
+      slots_[i] = old[k];
+    }
+  }
+
+  vector<Slot> slots_;
+  int size_;
+  size_t mask_;
+  Hasher hasher_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(S2FlatHashMap);
+};
+
+#endif  // UTIL_GEOMETRY_S2FLATHASHMAP_H_
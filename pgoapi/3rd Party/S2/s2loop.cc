@@ -13,13 +13,6 @@ using std::multiset;
 #include <vector>
 using std::vector;
 
-#if defined __GNUC__ || defined __APPLE__
-#include <ext/hash_map>
-#else
-#include <hash_map>
-#endif
-using __gnu_cxx::hash_map;
-
 #include <utility>
 using std::pair;
 using std::make_pair;
@@ -34,9 +27,23 @@ using std::make_pair;
 #include "s2cap.h"
 #include "s2cell.h"
 #include "s2edgeindex.h"
+#include "s2flathashmap.h"
+#include "s2polygonclassifier.h"
 
 static const unsigned char kCurrentEncodingVersionNumber = 1;
 
+DEFINE_bool(s2loop_use_point_index, true,
+            "Answer S2Loop::Contains(S2Point) for large loops that are "
+            "frozen or queried often with an S2PolygonClassifier");
+
+// Contains(S2Point) only builds a point index for loops with at least this
+// many vertices; smaller loops are fastest to test edge by edge.
+static int const kMinVerticesForPointIndex = 32;
+
+// The point index is built after this many calls to Contains(S2Point).
+// Building it costs roughly as much as this many queries without it.
+static int const kMinQueriesForPointIndex = 1024;
+
 S2Point const* S2LoopIndex::edge_from(int index) const {
   return &loop_->vertex(index);
 }
@@ -56,7 +63,9 @@ S2Loop::S2Loop()
     bound_(S2LatLngRect::Empty()),
     depth_(0),
     index_(this),
-    num_find_vertex_calls_(0) {
+    num_find_vertex_calls_(0),
+    num_contains_point_calls_(0),
+    frozen_(false) {
 }
 
 S2Loop::S2Loop(vector<S2Point> const& vertices)
@@ -66,14 +75,19 @@ S2Loop::S2Loop(vector<S2Point> const& vertices)
     bound_(S2LatLngRect::Full()),
     depth_(0),
     index_(this),
-    num_find_vertex_calls_(0) {
+    num_find_vertex_calls_(0),
+    num_contains_point_calls_(0),
+    frozen_(false) {
   Init(vertices);
 }
 
 void S2Loop::ResetMutableFields() {
   index_.Reset();
   num_find_vertex_calls_ = 0;
-  vertex_to_index_.clear();
+  vertex_to_index_.Clear();
+  num_contains_point_calls_ = 0;
+  point_index_.reset(NULL);
+  frozen_ = false;
 }
 
 void S2Loop::Init(vector<S2Point> const& vertices) {
@@ -110,10 +124,12 @@ bool S2Loop::IsValid() const {
     }
   }
   // Loops are not allowed to have any duplicate vertices.
-  hash_map<S2Point, int> vmap;
+  S2FlatHashMap<S2Point, int> vmap;
+  vmap.Reserve(num_vertices());
   for (int i = 0; i < num_vertices(); ++i) {
-    if (!vmap.insert(make_pair(vertex(i), i)).second) {
-      VLOG(2) << "Duplicate vertices: " << vmap[vertex(i)] << " and " << i;
+    pair<int*, bool> result = vmap.Insert(vertex(i), i);
+    if (!result.second) {
+      VLOG(2) << "Duplicate vertices: " << *result.first << " and " << i;
       return false;
     }
   }
@@ -220,7 +236,9 @@ void S2Loop::InitBound() {
 S2Loop::S2Loop(S2Cell const& cell)
     : bound_(cell.GetRectBound()),
       index_(this),
-      num_find_vertex_calls_(0) {
+      num_find_vertex_calls_(0),
+      num_contains_point_calls_(0),
+      frozen_(false) {
   num_vertices_ = 4;
   vertices_ = new S2Point[num_vertices_];
   depth_ = 0;
@@ -246,7 +264,9 @@ S2Loop::S2Loop(S2Loop const* src)
     origin_inside_(src->origin_inside_),
     depth_(src->depth_),
     index_(this),
-    num_find_vertex_calls_(0) {
+    num_find_vertex_calls_(0),
+    num_contains_point_calls_(0),
+    frozen_(false) {
   memcpy(vertices_, src->vertices_, num_vertices_ * sizeof(vertices_[0]));
 }
 
@@ -254,9 +274,18 @@ S2Loop* S2Loop::Clone() const {
   return new S2Loop(this);
 }
 
+void S2Loop::InitVertexToIndex() const {
+  vertex_to_index_.Reserve(num_vertices());
+  for (int i = num_vertices(); i > 0; --i) {
+    vertex_to_index_.Set(vertex(i), i);
+  }
+}
+
 int S2Loop::FindVertex(S2Point const& p) const {
-  num_find_vertex_calls_++;
-  if (num_vertices() < 10 || num_find_vertex_calls_ < 20) {
+  // A frozen loop may be shared between threads, so it must not update the
+  // call count.  Freeze() has already built the map if it is worth using.
+  if (!frozen_) num_find_vertex_calls_++;
+  if (num_vertices() < 10 || (!frozen_ && num_find_vertex_calls_ < 20)) {
     // Exhaustive search
     for (int i = 1; i <= num_vertices(); ++i) {
       if (vertex(i) == p) return i;
@@ -265,15 +294,12 @@ int S2Loop::FindVertex(S2Point const& p) const {
   }
 
   if (vertex_to_index_.empty()) {  // We haven't computed it yet.
-    for (int i = num_vertices(); i > 0; --i) {
-      vertex_to_index_[vertex(i)] = i;
-    }
+    DCHECK(!frozen_);
+    InitVertexToIndex();
   }
 
-  map<S2Point, int>::const_iterator it;
-  it = vertex_to_index_.find(p);
-  if (it == vertex_to_index_.end()) return -1;
-  return it->second;
+  int const* index = vertex_to_index_.Find(p);
+  return (index == NULL) ? -1 : *index;
 }
 
 
@@ -390,6 +416,21 @@ bool S2Loop::MayIntersect(S2Cell const& cell) const {
 }
 
 bool S2Loop::Contains(S2Point const& p) const {
+  if (point_index_.get() == NULL) {
+    // A frozen loop may be shared between threads, so it must not update
+    // the call count.  Freeze() has already built the index if it is worth
+    // using.
+    if (!FLAGS_s2loop_use_point_index || frozen_ ||
+        num_vertices() < kMinVerticesForPointIndex ||
+        ++num_contains_point_calls_ < kMinQueriesForPointIndex) {
+      return ContainsByCrossings(p);
+    }
+    InitPointIndex();
+  }
+  return bound_.Contains(p) && point_index_->Contains(p);
+}
+
+bool S2Loop::ContainsByCrossings(S2Point const& p) const {
   if (!bound_.Contains(p)) return false;
 
   bool inside = origin_inside_;
@@ -399,9 +440,10 @@ bool S2Loop::Contains(S2Point const& p) const {
   // The s2edgeindex library is not optimized yet for long edges,
   // so the tradeoff to using it comes later.
   if (num_vertices() < 2000) {
-    for (int i = 1; i <= num_vertices(); ++i) {
-      inside ^= crosser.EdgeOrVertexCrossing(&vertex(i));
-    }
+    // vertex(1..n-1) are contiguous, and vertex(n) is vertex(0).
+    inside ^= crosser.CountEdgeOrVertexCrossings(&vertex(1),
+                                                 num_vertices() - 1) & 1;
+    inside ^= crosser.EdgeOrVertexCrossing(&vertex(0));
     return inside;
   }
 
@@ -416,6 +458,19 @@ bool S2Loop::Contains(S2Point const& p) const {
   return inside;
 }
 
+void S2Loop::InitPointIndex() const {
+  // Cells about half as wide as the average edge is long have only a few
+  // edges each, so points in boundary cells are cheap to test, and there
+  // are only a few cells per edge.
+  double perimeter = 0;
+  for (int i = 0; i < num_vertices(); ++i) {
+    perimeter += vertex(i).Angle(vertex(i + 1));
+  }
+  int const level =
+      S2::kAvgEdge.GetClosestLevel(perimeter / (2 * num_vertices()));
+  point_index_.reset(new S2PolygonClassifier(this, level));
+}
+
 void S2Loop::Encode(Encoder* const encoder) const {
   encoder->Ensure(num_vertices_ * sizeof(*vertices_) + 20);  // sufficient
 
@@ -442,6 +497,7 @@ bool S2Loop::DecodeInternal(Decoder* const decoder,
   unsigned char version = decoder->get8();
   if (version > kCurrentEncodingVersionNumber) return false;
 
+  ResetMutableFields();
   num_vertices_ = decoder->get32();
   if (owns_vertices_) delete[] vertices_;
   if (within_scope) {
@@ -533,6 +589,21 @@ class ContainsWedgeProcessor: public WedgeProcessor {
   bool doesnt_contain_;
 };
 
+void S2Loop::BuildIndex(int num_threads) const {
+  if (!index_.IsIndexComputed()) index_.ComputeIndex(num_threads);
+}
+
+void S2Loop::Freeze(int num_threads) {
+  BuildIndex(num_threads);
+  if (num_vertices() >= 10 && vertex_to_index_.empty()) InitVertexToIndex();
+  if (FLAGS_s2loop_use_point_index &&
+      num_vertices() >= kMinVerticesForPointIndex &&
+      point_index_.get() == NULL) {
+    InitPointIndex();
+  }
+  frozen_ = true;
+}
+
 bool S2Loop::Contains(S2Loop const* b) const {
   // For this loop A to contains the given loop B, all of the following must
   // be true:
@@ -13,12 +13,15 @@ using std::vector;
 
 #include "logging.h"
 #include "macros.h"
+#include "scoped_ptr.h"
 #include "s2edgeindex.h"
+#include "s2flathashmap.h"
 #include "s2region.h"
 #include "s2latlngrect.h"
 #include "s2edgeutil.h"
 
 class S2Loop;
+class S2PolygonClassifier;
 // Defined in the cc file. A helper class for AreBoundariesCrossing.
 class WedgeProcessor;
 
@@ -186,6 +189,27 @@ class S2Loop : public S2Region {
   // tests.  TODO: fix ContainsOrCrosses() and revert CL 2926852.
   int ContainsOrCrosses(S2Loop const* b) const;
 
+  // Builds the edge index used by Contains(S2Loop), Intersects(),
+  // ContainsOrCrosses() and, for loops with many vertices, Contains(S2Point)
+  // now rather than lazily during the first of these calls, e.g. so that
+  // large loops can be indexed when they are loaded.  If "num_threads" > 1,
+  // the index of a large loop is built on up to that many threads.  Does
+  // nothing if the index has already been built.
+  void BuildIndex(int num_threads = 1) const;
+
+  // Builds all the lazily computed data used by queries (the edge index,
+  // the vertex lookup map and, if enabled, the point index) and stops the
+  // loop from updating the statistics that decide when to build them.
+  // After this, all const methods of the loop may be called concurrently
+  // from any number of threads, so a single loop can be shared by all the
+  // threads that query it instead of being cloned per thread.  Methods that
+  // take another loop or polygon also read the lazy data of their argument,
+  // which must then be frozen as well.
+  // Modifying the loop (e.g. with Init(), Invert() or Decode()) unfreezes it.
+  // "num_threads" is passed to BuildIndex().
+  void Freeze(int num_threads = 1);
+  bool is_frozen() const { return frozen_; }
+
   // Return true if two loops have the same boundary.  This is true if and
   // only if the loops have the same vertices in the same cyclic order.
   // (For testing purposes.)
@@ -251,6 +275,13 @@ class S2Loop : public S2Region {
   }
 
   // The point 'p' does not need to be normalized.
+  //
+  // Loops with more than a few dozen vertices build a grid of cells (see
+  // S2PolygonClassifier) once they have answered enough queries or are
+  // frozen, after which most points are classified by a cell lookup plus a
+  // few edge crossing tests instead of testing every edge.  The results are
+  // the same either way.  Setting FLAGS_s2loop_use_point_index to false
+  // turns this off.
   bool Contains(S2Point const& p) const;
 
   virtual void Encode(Encoder* const encoder) const;
@@ -258,10 +289,20 @@ class S2Loop : public S2Region {
   virtual bool DecodeWithinScope(Decoder* const decoder);
 
  private:
+  // S2PolygonClassifier calls ContainsByCrossings().
+  friend class S2PolygonClassifier;
+
   // Internal constructor used only by Clone() that makes a deep copy of
   // its argument.
   explicit S2Loop(S2Loop const* src);
 
+  // Implements Contains(S2Point) without the point index, by counting the
+  // edges crossed on the way from S2::Origin() to "p".
+  bool ContainsByCrossings(S2Point const& p) const;
+
+  // Fills point_index_.
+  void InitPointIndex() const;
+
   void InitOrigin();
   void InitBound();
 
@@ -309,6 +350,9 @@ class S2Loop : public S2Region {
   // the indexing structures need to be deleted as they become invalid.
   void ResetMutableFields();
 
+  // Fills vertex_to_index_.
+  void InitVertexToIndex() const;
+
   // We store the vertices in an array rather than a vector because we don't
   // need any STL methods, and computing the number of vertices using size()
   // would be relatively expensive (due to division by sizeof(S2Point) == 24).
@@ -329,7 +373,15 @@ class S2Loop : public S2Region {
   // Map for speeding up FindVertex: We will compute a map from vertex to
   // index in the vertex array as soon as there has been enough calls.
   mutable int num_find_vertex_calls_;
-  mutable map<S2Point, int> vertex_to_index_;
+  mutable S2FlatHashMap<S2Point, int> vertex_to_index_;
+
+  // Cell grid for speeding up Contains(S2Point), computed once there have
+  // been enough calls.
+  mutable int num_contains_point_calls_;
+  mutable scoped_ptr<S2PolygonClassifier> point_index_;
+
+  // True if Freeze() has been called since the loop was last modified.
+  bool frozen_;
 
   DISALLOW_EVIL_CONSTRUCTORS(S2Loop);
 };
@@ -392,7 +444,11 @@ T S2Loop::GetSurfaceIntegral(T f_tri(S2Point const&, S2Point const&,
     DCHECK(i == 1 || origin.Angle(vertex(i)) < kMaxLength);
     DCHECK(origin == vertex(0) || fabs(origin.DotProd(vertex(0))) < 1e-15);
 
-    if (vertex(i+1).Angle(origin) > kMaxLength) {
+    // Angle() costs an atan2(), so it is only called for vertices that are
+    // more than about 2*Pi/3 from the origin according to the dot product.
+    // Closer vertices are well within kMaxLength.
+    if (origin.DotProd(vertex(i+1)) < -0.5 &&
+        vertex(i+1).Angle(origin) > kMaxLength) {
       // We are about to create an unstable edge, so choose a new origin O'
       // for the triangle fan.
       S2Point old_origin = origin;
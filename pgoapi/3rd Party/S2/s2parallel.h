@@ -0,0 +1,30 @@
+// Helpers for splitting S2 computations across threads.  These are used
+// internally by the library and are not part of its public interface.
+
+#ifndef UTIL_GEOMETRY_S2PARALLEL_H_
+#define UTIL_GEOMETRY_S2PARALLEL_H_
+
+#include <pthread.h>
+
+#include <vector>
+using std::vector;
+
+// Runs fn(&(*tasks)[t]) for every task, each on its own thread except the
+// first, which runs on the calling thread.  A task whose thread cannot be
+// created also runs on the calling thread.  Returns when all tasks are done.
+template <class Task>
+void S2RunTasks(vector<Task>* tasks, void* (*fn)(void*)) {
+  int const num_tasks = tasks->size();
+  vector<pthread_t> threads(num_tasks);
+  vector<bool> started(num_tasks, false);
+  for (int t = 1; t < num_tasks; ++t) {
+    started[t] = pthread_create(&threads[t], NULL, fn, &(*tasks)[t]) == 0;
+    if (!started[t]) fn(&(*tasks)[t]);
+  }
+  if (num_tasks > 0) fn(&(*tasks)[0]);
+  for (int t = 1; t < num_tasks; ++t) {
+    if (started[t]) pthread_join(threads[t], NULL);
+  }
+}
+
+#endif  // UTIL_GEOMETRY_S2PARALLEL_H_
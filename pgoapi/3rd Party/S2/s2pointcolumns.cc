@@ -0,0 +1,68 @@
+#include "s2pointcolumns.h"
+
+#include <stdint.h>
+
+#include "logging.h"
+
+// The alignment of each coordinate array, which is the size of an AVX
+// vector.  Loops process this many points at a time.
+static size_t const kColumnAlignBytes = 32;
+static int const kPointsPerVector = kColumnAlignBytes / sizeof(double);
+
+S2PointColumns::S2PointColumns(S2Point const* points, int n)
+  : size_(n),
+    padded_size_(((n + kPointsPerVector - 1) & -kPointsPerVector) +
+                 kPointsPerVector),
+    storage_(3 * padded_size_ + kPointsPerVector, 0.0) {
+  DCHECK_GE(n, 0);
+  uintptr_t const base = reinterpret_cast<uintptr_t>(&storage_[0]);
+  x_ = &storage_[0] + (-base & (kColumnAlignBytes - 1)) / sizeof(double);
+  y_ = x_ + padded_size_;
+  z_ = y_ + padded_size_;
+  for (int i = 0; i < n; ++i) {
+    x_[i] = points[i][0];
+    y_[i] = points[i][1];
+    z_[i] = points[i][2];
+  }
+}
+
+// The loops below are written as whole vectors of kPointsPerVector points,
+// which the compiler turns into vector instructions without needing to
+// handle a partial last vector.
+
+void S2PointColumns::GetDistances2(S2Point const& p, double* dist2) const {
+  double const* x = x_;
+  double const* y = y_;
+  double const* z = z_;
+  double const px = p[0], py = p[1], pz = p[2];
+  for (int i = 0; i < padded_size_; i += kPointsPerVector) {
+    for (int k = i; k < i + kPointsPerVector; ++k) {
+      double const dx = px - x[k], dy = py - y[k], dz = pz - z[k];
+      dist2[k] = dx * dx + dy * dy + dz * dz;
+    }
+  }
+}
+
+void S2PointColumns::GetChainProducts(int begin, int end,
+                                      double* __restrict__ cross2,
+                                      double* __restrict__ dot) const {
+  DCHECK_EQ(begin % kPointsPerVector, 0);
+  DCHECK_LE(end, size_ - 1);
+  // The outputs never overlap the columns, which the compiler cannot prove
+  // by itself because the loop also reads the next point.
+  double const* __restrict__ x = x_ + begin;
+  double const* __restrict__ y = y_ + begin;
+  double const* __restrict__ z = z_ + begin;
+  // "end" rounded up to a whole vector is at most size() rounded up, which
+  // is less than padded_size(), so reading the next point stays in bounds.
+  int const n = (end - begin + kPointsPerVector - 1) & -kPointsPerVector;
+  for (int i = 0; i < n; i += kPointsPerVector) {
+    for (int k = i; k < i + kPointsPerVector; ++k) {
+      double const cx = y[k] * z[k + 1] - z[k] * y[k + 1];
+      double const cy = z[k] * x[k + 1] - x[k] * z[k + 1];
+      double const cz = x[k] * y[k + 1] - y[k] * x[k + 1];
+      cross2[k] = cx * cx + cy * cy + cz * cz;
+      dot[k] = x[k] * x[k + 1] + y[k] * y[k + 1] + z[k] * z[k + 1];
+    }
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef UTIL_GEOMETRY_S2POINTCOLUMNS_H_
+#define UTIL_GEOMETRY_S2POINTCOLUMNS_H_
+
+#include <vector>
+using std::vector;
+
+#include "macros.h"
+#include "s2.h"
+
+// An S2PointColumns is a copy of a sequence of points stored as three
+// separate arrays of x, y, and z coordinates ("structure of arrays").  An
+// array of S2Points interleaves the coordinates, so a loop that computes the
+// same quantity for every point cannot load the coordinates of several
+// consecutive points into one vector register.  With separate arrays it can,
+// and the compiler vectorizes the simple loops below by itself.
+//
+// Each array is aligned to 32 bytes and padded with at least four zeros to
+// padded_size() entries, a multiple of 4, so the loops always process whole
+// vectors and may read the point after the last one.  The per-point
+// results are computed with the same operations, in the same order, as the
+// corresponding S2Point methods, so they are identical to the values those
+// methods would return.
+//
+// The copy does not refer to the original points after construction.  All
+// methods are const and may be called concurrently from any number of
+// threads.
+class S2PointColumns {
+ public:
+  S2PointColumns(S2Point const* points, int n);
+
+  int size() const { return size_; }
+  int padded_size() const { return padded_size_; }
+
+  double const* x() const { return x_; }
+  double const* y() const { return y_; }
+  double const* z() const { return z_; }
+
+  // Sets dist2[i] to (p - point(i)).Norm2() for each i < size().  "dist2"
+  // must have room for padded_size() entries.
+  void GetDistances2(S2Point const& p, double* dist2) const;
+
+  // Treats the points as a chain and sets cross2[i - begin] to
+  // point(i).CrossProd(point(i + 1)).Norm2() and dot[i - begin] to
+  // point(i).DotProd(point(i + 1)) for each i in [begin, end), from which
+  // point(i).Angle(point(i + 1)) is atan2(sqrt(cross2[i - begin]),
+  // dot[i - begin]).  "begin" must be a multiple of 4 and "end" at most
+  // size() - 1.  Both arrays must have room for (end - begin) rounded up to
+  // a multiple of 4 entries.
+  void GetChainProducts(int begin, int end, double* cross2,
+                        double* dot) const;
+
+ private:
+  int size_;
+  int padded_size_;
+  double* x_;
+  double* y_;
+  double* z_;
+
+  // Backing storage for x_, y_, and z_.
+  vector<double> storage_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(S2PointColumns);
+};
+
+#endif  // UTIL_GEOMETRY_S2POINTCOLUMNS_H_
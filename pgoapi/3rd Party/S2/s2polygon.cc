@@ -6,13 +6,6 @@ using std::max;
 using std::swap;
 using std::reverse;
 
-#if defined __GNUC__ || defined __APPLE__
-#include <ext/hash_map>
-#else
-#include <hash_map>
-#endif
-using __gnu_cxx::hash_map;
-
 #include <set>
 using std::set;
 using std::multiset;
@@ -27,10 +20,13 @@ using std::vector;
 #include "port.h"  // for HASH_NAMESPACE_DECLARATION_START
 #include "coder.h"
 #include "s2edgeindex.h"
+#include "s2flathashmap.h"
 #include "s2cap.h"
 #include "s2cell.h"
+#include "s2cellid.h"
 #include "s2cellunion.h"
 #include "s2latlngrect.h"
+#include "s2parallel.h"
 #include "s2polygonbuilder.h"
 #include "s2polyline.h"
 
@@ -131,17 +127,24 @@ template<> struct hash<S2PointPair> {
 bool S2Polygon::IsValid(const vector<S2Loop*>& loops) {
   // If a loop contains an edge AB, then no other loop may contain AB or BA.
   if (loops.size() > 1) {
-    hash_map<S2PointPair, pair<int, int> > edges;
+    int num_edges = 0;
+    for (int i = 0; i < loops.size(); ++i) {
+      num_edges += loops[i]->num_vertices();
+    }
+    S2FlatHashMap<S2PointPair, pair<int, int> > edges;
+    edges.Reserve(2 * num_edges);
     for (int i = 0; i < loops.size(); ++i) {
       S2Loop* lp = loops[i];
       for (int j = 0; j < lp->num_vertices(); ++j) {
         S2PointPair key = make_pair(lp->vertex(j), lp->vertex(j + 1));
-        if (edges.insert(make_pair(key, make_pair(i, j))).second) {
+        pair<pair<int, int>*, bool> result =
+            edges.Insert(key, make_pair(i, j));
+        if (result.second) {
           key = make_pair(lp->vertex(j + 1), lp->vertex(j));
-          if (edges.insert(make_pair(key, make_pair(i, j))).second)
-            continue;
+          result = edges.Insert(key, make_pair(i, j));
+          if (result.second) continue;
         }
-        pair<int, int> other = edges[key];
+        pair<int, int> other = *result.first;
         VLOG(2) << "Duplicate edge: loop " << i << ", edge " << j
                  << " and loop " << other.first << ", edge " << other.second;
         return false;
@@ -410,6 +413,18 @@ bool S2Polygon::Contains(S2Polygon const* b) const {
   return ContainsAllShells(b) && b->ExcludesAllHoles(this);
 }
 
+void S2Polygon::BuildIndex(int num_threads) const {
+  for (int i = 0; i < num_loops(); ++i) {
+    loop(i)->BuildIndex(num_threads);
+  }
+}
+
+void S2Polygon::Freeze(int num_threads) {
+  for (int i = 0; i < num_loops(); ++i) {
+    loop(i)->Freeze(num_threads);
+  }
+}
+
 bool S2Polygon::Intersects(S2Polygon const* b) const {
   // A.Intersects(B) if and only if !Complement(A).Contains(B).  However,
   // implementing a Complement() operation is trickier than it sounds,
@@ -1067,6 +1082,142 @@ S2Polygon* S2Polygon::DestructiveUnionSloppy(vector<S2Polygon*>* polygons,
     return queue.begin()->second;
 }
 
+namespace {
+
+// A node of the merge tree used by DestructiveUnionParallel().  Leaves hold
+// the input polygons, and each internal node holds the union of its two
+// children once it has been computed.
+struct UnionNode {
+  S2Polygon* polygon;
+  int child[2];
+  int parent;
+  int children_done;
+};
+
+// The state shared by the threads of DestructiveUnionParallel().  Internal
+// nodes whose children are both done wait in "ready" until a thread merges
+// them.
+struct UnionTree {
+  vector<UnionNode> nodes;
+  int root;
+  S1Angle vertex_merge_radius;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;  // Signalled when "ready" grows or the root is done.
+  vector<int> ready;
+  bool done;
+};
+
+// Adds a subtree over leaves [begin, end) of "polygons" to "tree" and
+// returns its root.
+int BuildUnionTree(vector<S2Polygon*> const& polygons, int begin, int end,
+                   UnionTree* tree) {
+  int const id = tree->nodes.size();
+  tree->nodes.push_back(UnionNode());
+  UnionNode* node = &tree->nodes[id];
+  node->parent = -1;
+  node->children_done = 0;
+  if (end - begin == 1) {
+    node->polygon = polygons[begin];
+    node->child[0] = node->child[1] = -1;
+    return id;
+  }
+  node->polygon = NULL;
+  int const middle = begin + (end - begin) / 2;
+  int const left = BuildUnionTree(polygons, begin, middle, tree);
+  int const right = BuildUnionTree(polygons, middle, end, tree);
+  // "node" may have been invalidated by the recursive calls.
+  node = &tree->nodes[id];
+  node->child[0] = left;
+  node->child[1] = right;
+  for (int i = 0; i < 2; ++i) {
+    tree->nodes[node->child[i]].parent = id;
+    if (tree->nodes[node->child[i]].polygon != NULL) ++node->children_done;
+  }
+  if (node->children_done == 2) tree->ready.push_back(id);
+  return id;
+}
+
+void* RunUnionTask(void* arg) {
+  UnionTree* tree = *static_cast<UnionTree**>(arg);
+  pthread_mutex_lock(&tree->mutex);
+  for (;;) {
+    while (tree->ready.empty() && !tree->done) {
+      pthread_cond_wait(&tree->cond, &tree->mutex);
+    }
+    if (tree->done) break;
+    int const id = tree->ready.back();
+    tree->ready.pop_back();
+    UnionNode* node = &tree->nodes[id];
+    S2Polygon* a = tree->nodes[node->child[0]].polygon;
+    S2Polygon* b = tree->nodes[node->child[1]].polygon;
+    pthread_mutex_unlock(&tree->mutex);
+
+    S2Polygon* union_polygon = new S2Polygon();
+    union_polygon->InitToUnionSloppy(a, b, tree->vertex_merge_radius);
+    delete a;
+    delete b;
+
+    pthread_mutex_lock(&tree->mutex);
+    node->polygon = union_polygon;
+    if (id == tree->root) {
+      tree->done = true;
+      pthread_cond_broadcast(&tree->cond);
+    } else if (++tree->nodes[node->parent].children_done == 2) {
+      tree->ready.push_back(node->parent);
+      pthread_cond_signal(&tree->cond);
+    }
+  }
+  pthread_mutex_unlock(&tree->mutex);
+  return NULL;
+}
+
+}  // namespace
+
+S2Polygon* S2Polygon::DestructiveUnionParallel(vector<S2Polygon*>* polygons,
+                                               S1Angle vertex_merge_radius,
+                                               UnionPairing pairing,
+                                               int num_threads) {
+  int const n = polygons->size();
+  if (n == 0) return new S2Polygon();
+
+  // Order the polygons so that the ones to be merged first are adjacent.
+  // Ties are broken by the original position, so the order (and therefore
+  // the result) does not depend on the sort implementation.
+  vector<pair<uint64, int> > keys(n);
+  for (int i = 0; i < n; ++i) {
+    S2Polygon const* polygon = (*polygons)[i];
+    if (pairing == PAIR_BY_SIZE) {
+      keys[i].first = polygon->num_vertices();
+    } else {
+      S2Point const center = polygon->GetRectBound().GetCenter().ToPoint();
+      keys[i].first = S2CellId::FromPoint(center).id();
+    }
+    keys[i].second = i;
+  }
+  sort(keys.begin(), keys.end());
+  vector<S2Polygon*> ordered(n);
+  for (int i = 0; i < n; ++i) ordered[i] = (*polygons)[keys[i].second];
+  polygons->clear();
+
+  UnionTree tree;
+  tree.nodes.reserve(2 * n - 1);
+  tree.vertex_merge_radius = vertex_merge_radius;
+  tree.done = false;
+  tree.root = BuildUnionTree(ordered, 0, n, &tree);
+  if (n == 1) return tree.nodes[tree.root].polygon;
+
+  // At most n / 2 pairs can be merged at the same time.
+  num_threads = max(1, min(num_threads, n / 2));
+  pthread_mutex_init(&tree.mutex, NULL);
+  pthread_cond_init(&tree.cond, NULL);
+  vector<UnionTree*> tasks(num_threads, &tree);
+  S2RunTasks(&tasks, RunUnionTask);
+  pthread_cond_destroy(&tree.cond);
+  pthread_mutex_destroy(&tree.mutex);
+  return tree.nodes[tree.root].polygon;
+}
+
 void S2Polygon::InitToCellUnionBorder(S2CellUnion const& cells) {
   // Use a polygon builder to union the cells in the union.  Due to rounding
   // errors, we can't do an exact union - when a small cell is adjacent to a
@@ -134,6 +134,16 @@ class S2Polygon : public S2Region {
   // if there is a point that is contained by both polygons.
   bool Intersects(S2Polygon const* b) const;
 
+  // Builds the edge indexes of all the loops now rather than lazily during
+  // the first query that needs them (see S2Loop::BuildIndex()).
+  void BuildIndex(int num_threads = 1) const;
+
+  // Freezes all the loops (see S2Loop::Freeze()).  After this, all const
+  // methods of the polygon may be called concurrently from any number of
+  // threads, provided that any polygons or loops passed to them are frozen
+  // too.  Reinitializing the polygon discards the frozen loops.
+  void Freeze(int num_threads = 1);
+
   // Initialize this polygon to the intersection, union, or difference
   // (A - B) of the given two polygons.  The "vertex_merge_radius" determines
   // how close two vertices must be to be merged together and how close a
@@ -210,6 +220,32 @@ class S2Polygon : public S2Region {
   static S2Polygon* DestructiveUnionSloppy(vector<S2Polygon*>* polygons,
                                            S1Angle vertex_merge_radius);
 
+  // How DestructiveUnionParallel() pairs up the polygons to be merged.
+  enum UnionPairing {
+    // Pairs polygons with similar numbers of vertices, smallest first, like
+    // DestructiveUnionSloppy().
+    PAIR_BY_SIZE,
+
+    // Pairs polygons that are close to each other, in the Hilbert curve
+    // order of their bounding rectangle centers.  Nearby polygons usually
+    // overlap, so merging them first keeps the intermediate unions small.
+    // This is much faster for many small polygons spread over an area,
+    // such as the circles around a set of locations.
+    PAIR_BY_HILBERT_ORDER
+  };
+
+  // Like DestructiveUnionSloppy(), but merges the polygons as a balanced
+  // binary tree, ordered as given by "pairing", and merges independent pairs
+  // concurrently on up to "num_threads" threads.  A pair is merged as soon
+  // as both of its halves are ready, by whichever thread is free.  The
+  // result covers the same region as DestructiveUnionSloppy() would, but
+  // may have different vertices within "vertex_merge_radius" of the
+  // boundary, since the polygons are merged in a different order.
+  static S2Polygon* DestructiveUnionParallel(vector<S2Polygon*>* polygons,
+                                             S1Angle vertex_merge_radius,
+                                             UnionPairing pairing,
+                                             int num_threads);
+
   // Initialize this polygon to the outline of the given cell union.
   // In principle this polygon should exactly contain the cell union and
   // this polygon's inverse should not intersect the cell union, but rounding
@@ -8,20 +8,6 @@ using std::max;
 using std::swap;
 using std::reverse;
 
-#if defined __GNUC__ || defined __APPLE__
-#include <ext/hash_map>
-#else
-#include <hash_map>
-#endif
-using __gnu_cxx::hash_map;
-
-#if defined __GNUC__ || defined __APPLE__
-#include <ext/hash_set>
-#else
-#include <hash_set>
-#endif
-using __gnu_cxx::hash_set;
-
 #include <iomanip>
 using std::setprecision;
 
@@ -47,6 +33,7 @@ using std::vector;
 #include "scoped_ptr.h"
 #include "s2.h"
 #include "s2cellid.h"
+#include "s2flathashmap.h"
 #include "s2polygon.h"
 #include "matrix3x3-inl.h"
 
@@ -186,11 +173,11 @@ S2Loop* S2PolygonBuilder::AssembleLoop(S2Point const& v0, S2Point const& v1,
   // vertex that we have seen before *except* for the first vertex (v0).
   // This ensures that only CCW loops are constructed when possible.
 
-  vector<S2Point> path;          // The path so far.
-  hash_map<S2Point, int> index;  // Maps a vertex to its index in "path".
+  vector<S2Point> path;               // The path so far.
+  S2FlatHashMap<S2Point, int> index;  // Maps a vertex to its index in "path".
   path.push_back(v0);
   path.push_back(v1);
-  index[v1] = 1;
+  index.Set(v1, 1);
   while (path.size() >= 2) {
     // Note that "v0" and "v1" become invalid if "path" is modified.
     S2Point const& v0 = path.end()[-2];
@@ -211,15 +198,15 @@ S2Loop* S2PolygonBuilder::AssembleLoop(S2Point const& v0, S2Point const& v1,
       // We've hit a dead end.  Remove this edge and backtrack.
       unused_edges->push_back(make_pair(v0, v1));
       EraseEdge(v0, v1);
-      index.erase(v1);
+      index.Erase(v1);
       path.pop_back();
-    } else if (index.insert(make_pair(v2, path.size())).second) {
+    } else if (index.Insert(v2, path.size()).second) {
       // This is the first time we've visited this vertex.
       path.push_back(v2);
     } else {
       // We've completed a loop.  Throw away any initial vertices that
       // are not part of the loop.
-      path.erase(path.begin(), path.begin() + index[v2]);
+      path.erase(path.begin(), path.begin() + *index.Find(v2));
 
       // In the case of undirected edges, we may have assembled a clockwise
       // loop while trying to assemble a CCW loop.  To fix this, we assemble
@@ -371,18 +358,21 @@ void S2PolygonBuilder::BuildMergeMap(PointIndex* index, MergeMap* merge_map) {
   // creating new vertex pairs that need to be merged.  (We guarantee that all
   // vertex pairs are separated by at least the merge radius in the output.)
 
-  // First, we build the set of all the distinct vertices in the input.
+  // First, we build the list of all the distinct vertices in the input.
   // We need to include the source and destination of every edge.
-  hash_set<S2Point> vertices;
+  vector<S2Point> vertices;
+  S2FlatHashMap<S2Point, bool> seen;
+  seen.Reserve(edges_->size());
   for (EdgeSet::const_iterator i = edges_->begin(); i != edges_->end(); ++i) {
-    vertices.insert(i->first);
+    if (seen.Insert(i->first, true).second) vertices.push_back(i->first);
     VertexSet const& vset = i->second;
-    for (VertexSet::const_iterator j = vset.begin(); j != vset.end(); ++j)
-      vertices.insert(*j);
+    for (VertexSet::const_iterator j = vset.begin(); j != vset.end(); ++j) {
+      if (seen.Insert(*j, true).second) vertices.push_back(*j);
+    }
   }
 
   // Build a spatial index containing all the distinct vertices.
-  for (hash_set<S2Point>::const_iterator i = vertices.begin();
+  for (vector<S2Point>::const_iterator i = vertices.begin();
        i != vertices.end(); ++i) {
     index->Insert(*i);
   }
@@ -390,10 +380,10 @@ void S2PolygonBuilder::BuildMergeMap(PointIndex* index, MergeMap* merge_map) {
   // Next, we loop through all the vertices and attempt to grow a maximial
   // mergeable group starting from each vertex.
   vector<S2Point> frontier, mergeable;
-  for (hash_set<S2Point>::const_iterator vstart = vertices.begin();
+  for (vector<S2Point>::const_iterator vstart = vertices.begin();
        vstart != vertices.end(); ++vstart) {
     // Skip any vertices that have already been merged with another vertex.
-    if (merge_map->find(*vstart) != merge_map->end()) continue;
+    if (merge_map->Find(*vstart) != NULL) continue;
 
     // Grow a maximal mergeable component starting from "vstart", the
     // canonical representative of the mergeable group.
@@ -408,7 +398,7 @@ void S2PolygonBuilder::BuildMergeMap(PointIndex* index, MergeMap* merge_map) {
           // ensures that we won't try to merge the same vertex twice.
           index->Erase(v1);
           frontier.push_back(v1);
-          (*merge_map)[v1] = *vstart;
+          merge_map->Set(v1, *vstart);
         }
       }
     }
@@ -426,8 +416,7 @@ void S2PolygonBuilder::MoveVertices(MergeMap const& merge_map) {
     VertexSet const& vset = i->second;
     for (VertexSet::const_iterator j = vset.begin(); j != vset.end(); ++j) {
       S2Point const& v1 = *j;
-      if (merge_map.find(v0) != merge_map.end() ||
-          merge_map.find(v1) != merge_map.end()) {
+      if (merge_map.Find(v0) != NULL || merge_map.Find(v1) != NULL) {
         // We only need to modify one copy of each undirected edge.
         if (!options_.undirected_edges() || v0 < v1) {
           edges.push_back(make_pair(v0, v1));
@@ -443,10 +432,10 @@ void S2PolygonBuilder::MoveVertices(MergeMap const& merge_map) {
     S2Point v0 = edges[i].first;
     S2Point v1 = edges[i].second;
     EraseEdge(v0, v1);
-    MergeMap::const_iterator new0 = merge_map.find(v0);
-    if (new0 != merge_map.end()) v0 = new0->second;
-    MergeMap::const_iterator new1 = merge_map.find(v1);
-    if (new1 != merge_map.end()) v1 = new1->second;
+    S2Point const* new0 = merge_map.Find(v0);
+    if (new0 != NULL) v0 = *new0;
+    S2Point const* new1 = merge_map.Find(v1);
+    if (new1 != NULL) v1 = *new1;
     AddEdge(v0, v1);
   }
 }
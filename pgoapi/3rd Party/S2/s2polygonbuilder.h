@@ -24,6 +24,7 @@ using std::vector;
 #include "basictypes.h"
 #include "scoped_ptr.h"
 #include "s2.h"
+#include "s2flathashmap.h"
 #include "s1angle.h"
 #include "matrix3x3.h"
 
@@ -265,7 +266,7 @@ class S2PolygonBuilder {
   // current position to a new position, and also returns a spatial index
   // containing all of the vertices that do not need to be moved.
   class PointIndex;
-  typedef hash_map<S2Point, S2Point> MergeMap;
+  typedef S2FlatHashMap<S2Point, S2Point> MergeMap;
   void BuildMergeMap(PointIndex* index, MergeMap* merge_map);
 
   // Moves a set of vertices from old to new positions.
@@ -0,0 +1,335 @@
+#include "s2polygonclassifier.h"
+
+#include <algorithm>
+using std::lower_bound;
+using std::max;
+using std::min;
+
+#include <utility>
+using std::make_pair;
+
+#include "logging.h"
+#include "s2cell.h"
+#include "s2edgeutil.h"
+#include "s2loop.h"
+#include "s2parallel.h"
+#include "s2polygon.h"
+
+// Edges are kept for every cell that they come within this distance of in
+// (u,v)-space.  It covers the rounding errors of S2CellId::FromPoint(), the
+// cell vertices, and S2::FaceXYZtoUV(), which are a few times DBL_EPSILON.
+static double const kCellPaddingUV = 1e-14;
+
+// S2::RobustCCW() is not exact for points this close to the great circle
+// through two others (see S2::ExpensiveCCW), so counting crossings from the
+// cell center instead of from S2::Origin() could disagree with S2Loop about
+// points this close to an edge.
+static double const kNearEdgeDistance = 1e-13;
+
+// ContainsPoints() only splits its work across threads when each thread
+// gets at least this many points.
+static int const kMinPointsPerClassifyThread = 16384;
+
+// The cells are found by subdividing cells from the top down.  Each cell is
+// given the polygon edges that may intersect its parent, keeps the ones
+// that may intersect the cell itself, and passes those on to its children.
+// A cell that no edge intersects is entirely inside or entirely outside the
+// polygon, which is decided by its center.  The center of a child is inside
+// the polygon if the center of its parent is, unless the segment between
+// the two crosses an odd number of edges; that segment lies within the
+// parent, so only the parent's edges need to be tested.  Points in boundary
+// cells are classified the same way, starting from the cell center.
+//
+// Edges that lie along a cell boundary, and points that S2CellId::FromPoint
+// puts in a cell they are only just outside of, are on either side of the
+// boundary depending on rounding.  So each cell is padded by kCellPaddingUV
+// when its edges are chosen: a point is then always within the padded cell
+// it is looked up in, and so is the segment from the cell center to it,
+// which makes the exact test of a point near a cell boundary see every edge
+// that the segment may cross.  For the same reason a cell only counts as
+// interior if no edge comes near its boundary.  Points that are within
+// kNearEdgeDistance of one of their cell's edges are still tested against
+// every edge, starting from S2::Origin() like S2Loop does.
+//
+// Subdivision starts from the smallest cell that contains every vertex, as
+// long as no vertex is on its boundary.  Cells are convex, so that cell
+// contains every edge too, and the rest of the sphere is either entirely
+// inside or entirely outside the polygon.  Otherwise it starts from the six
+// face cells.
+//
+// S2RegionCoverer::GetInteriorCovering() could find the interior cells, but
+// it tests every cell with S2Polygon::Contains(S2Cell) and
+// MayIntersect(S2Cell), which each take time linear in the size of the
+// polygon.
+S2PolygonClassifier::S2PolygonClassifier(S2Polygon const* polygon,
+                                         int max_level)
+  : max_level_(max_level),
+    num_interior_cells_(0) {
+  vector<S2Loop const*> loops(polygon->num_loops());
+  for (int i = 0; i < loops.size(); ++i) loops[i] = polygon->loop(i);
+  Init(loops);
+}
+
+S2PolygonClassifier::S2PolygonClassifier(S2Loop const* loop, int max_level)
+  : max_level_(max_level),
+    num_interior_cells_(0) {
+  Init(vector<S2Loop const*>(1, loop));
+}
+
+void S2PolygonClassifier::Init(vector<S2Loop const*> const& loops) {
+  DCHECK_GE(max_level_, 0);
+  DCHECK_LE(max_level_, S2CellId::kMaxLevel);
+  for (int i = 0; i < loops.size(); ++i) {
+    loop_edges_begin_.push_back(edges_.size());
+    loop_bounds_.push_back(loops[i]->GetRectBound());
+    loop_origin_inside_.push_back(loops[i]->origin_inside_);
+    for (int j = 0; j < loops[i]->num_vertices(); ++j) {
+      S2Point const& a = loops[i]->vertex(j);
+      S2Point const& b = loops[i]->vertex(j + 1);
+      edges_.push_back(make_pair(a, b));
+      edge_normals_.push_back(S2::RobustCrossProd(a, b).Normalize());
+    }
+  }
+  loop_edges_begin_.push_back(edges_.size());
+  vector<int> all_edges(edges_.size());
+  for (int e = 0; e < all_edges.size(); ++e) all_edges[e] = e;
+  cell_edges_begin_.push_back(0);
+
+  S2CellId root;
+  if (FindRootCell(&root)) {
+    // Any cell other than "root" that shares its parent will do as a point
+    // outside it.
+    S2CellId outside = root.is_face()
+        ? S2CellId::FromFacePosLevel((root.face() + 1) % 6, 0, 0)
+        : (root == root.parent().child_begin() ? root.next()
+                                               : root.parent().child_begin());
+    bool const root_inside = ExactContains(root.ToPoint());
+    bool const outside_inside = ExactContains(outside.ToPoint());
+    for (int face = 0; face < 6; ++face) {
+      AddCellsAround(S2CellId::FromFacePosLevel(face, 0, 0), root,
+                     root_inside, outside_inside, all_edges);
+    }
+  } else {
+    for (int face = 0; face < 6; ++face) {
+      S2Cell cell(S2CellId::FromFacePosLevel(face, 0, 0));
+      AddCells(cell, ExactContains(cell.GetCenter()), all_edges);
+    }
+  }
+}
+
+bool S2PolygonClassifier::ExactContains(S2Point const& p) const {
+  // This is the same as S2Polygon::Contains(), but does not use (and so
+  // cannot recurse into) the loops' own point indexes.
+  bool inside = false;
+  S2Point const origin = S2::Origin();
+  for (int k = 0; k + 1 < loop_edges_begin_.size(); ++k) {
+    if (!loop_bounds_[k].Contains(p)) continue;
+    int const begin = loop_edges_begin_[k], end = loop_edges_begin_[k + 1];
+    bool loop_inside = loop_origin_inside_[k];
+    S2EdgeUtil::EdgeCrosser crosser(&origin, &p, &edges_[begin].first);
+    for (int e = begin; e < end; ++e) {
+      loop_inside ^= crosser.EdgeOrVertexCrossing(&edges_[e].second);
+    }
+    inside ^= loop_inside;
+  }
+  return inside;
+}
+
+bool S2PolygonClassifier::FindRootCell(S2CellId* root) const {
+  if (edges_.empty()) return false;
+  vector<S2CellId> leaves(edges_.size());
+  *root = leaves[0] = S2CellId::FromPoint(edges_[0].first);
+  for (int e = 1; e < edges_.size(); ++e) {
+    leaves[e] = S2CellId::FromPoint(edges_[e].first);
+    while (!root->contains(leaves[e])) {
+      if (root->is_face()) return false;  // The vertices span several faces.
+      *root = root->parent();
+    }
+  }
+  // Check that no vertex is in a leaf cell along the root's boundary.
+  int const size = root->GetSizeIJ();
+  for (int e = 0; e < leaves.size(); ++e) {
+    int i, j;
+    leaves[e].ToFaceIJOrientation(&i, &j, NULL);
+    int const di = i & (size - 1), dj = j & (size - 1);
+    if (di == 0 || dj == 0 || di == size - 1 || dj == size - 1) return false;
+  }
+  return true;
+}
+
+void S2PolygonClassifier::AddCellsAround(S2CellId const& id,
+                                         S2CellId const& root,
+                                         bool root_inside,
+                                         bool outside_inside,
+                                         vector<int> const& all_edges) {
+  if (id == root) {
+    AddCells(S2Cell(root), root_inside, all_edges);
+  } else if (id.contains(root)) {
+    for (S2CellId c = id.child_begin(); c != id.child_end(); c = c.next()) {
+      AddCellsAround(c, root, root_inside, outside_inside, all_edges);
+    }
+  } else if (outside_inside) {
+    AddCell(id, true, vector<int>());
+  }
+}
+
+S2PolygonClassifier::~S2PolygonClassifier() {
+}
+
+bool S2PolygonClassifier::EdgeMayIntersect(int face, double const uv[2][2],
+                                           S2Point const v[4],
+                                           int e) const {
+  S2Point const& a = edges_[e].first;
+  S2Point const& b = edges_[e].second;
+  double u, w;
+  if ((S2::FaceXYZtoUV(face, a, &u, &w) &&
+       u >= uv[0][0] && u <= uv[0][1] && w >= uv[1][0] && w <= uv[1][1]) ||
+      (S2::FaceXYZtoUV(face, b, &u, &w) &&
+       u >= uv[0][0] && u <= uv[0][1] && w >= uv[1][0] && w <= uv[1][1])) {
+    return true;
+  }
+  for (int k = 0; k < 4; ++k) {
+    if (S2EdgeUtil::RobustCrossing(a, b, v[k], v[(k + 1) & 3]) >= 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool S2PolygonClassifier::CrossesOddEdges(S2Point const& a, S2Point const& b,
+                                          int const* edge_ids,
+                                          int num_edges) const {
+  if (num_edges == 0) return false;
+  S2EdgeUtil::EdgeCrosser crosser(&a, &b, &edges_[edge_ids[0]].first);
+  bool odd = false;
+  for (int i = 0; i < num_edges; ++i) {
+    pair<S2Point, S2Point> const& edge = edges_[edge_ids[i]];
+    if (i > 0 && edge.first != edges_[edge_ids[i - 1]].second) {
+      crosser.RestartAt(&edge.first);
+    }
+    odd ^= crosser.EdgeOrVertexCrossing(&edge.second);
+  }
+  return odd;
+}
+
+void S2PolygonClassifier::AddCell(S2CellId const& id, bool center_inside,
+                                  vector<int> const& edges) {
+  cells_.push_back(id);
+  center_inside_.push_back(center_inside);
+  cell_edge_ids_.insert(cell_edge_ids_.end(), edges.begin(), edges.end());
+  cell_edges_begin_.push_back(cell_edge_ids_.size());
+  if (edges.empty()) ++num_interior_cells_;
+}
+
+void S2PolygonClassifier::AddCells(S2Cell const& cell, bool center_inside,
+                                   vector<int> const& parent_edges) {
+  double uv[2][2];
+  for (int d = 0; d < 2; ++d) {
+    uv[d][0] = cell.GetUVBound(d, 0) - kCellPaddingUV;
+    uv[d][1] = cell.GetUVBound(d, 1) + kCellPaddingUV;
+  }
+  // The vertices in the same order as S2Cell::GetVertex().
+  S2Point v[4];
+  for (int k = 0; k < 4; ++k) {
+    v[k] = S2::FaceUVtoXYZ(cell.face(), uv[0][(k >> 1) ^ (k & 1)],
+                           uv[1][k >> 1]).Normalize();
+  }
+  vector<int> edges;
+  for (int i = 0; i < parent_edges.size(); ++i) {
+    if (EdgeMayIntersect(cell.face(), uv, v, parent_edges[i])) {
+      edges.push_back(parent_edges[i]);
+    }
+  }
+  if (edges.empty() && !center_inside) return;
+  S2Cell children[4];
+  if (edges.empty() || cell.level() >= max_level_ ||
+      !cell.Subdivide(children)) {
+    AddCell(cell.id(), center_inside, edges);
+    return;
+  }
+  S2Point const center = cell.GetCenter();
+  for (int c = 0; c < 4; ++c) {
+    S2Point const child_center = children[c].GetCenter();
+    bool const inside = center_inside ^
+        CrossesOddEdges(center, child_center, &edges[0], edges.size());
+    AddCells(children[c], inside, edges);
+  }
+}
+
+int S2PolygonClassifier::FindCell(S2CellId const& leaf) const {
+  // See S2CellUnion::Contains(S2CellId) for details.
+  vector<S2CellId>::const_iterator i =
+      lower_bound(cells_.begin(), cells_.end(), leaf);
+  if (i != cells_.end() && i->range_min() <= leaf) return i - cells_.begin();
+  if (i != cells_.begin() && (--i)->range_max() >= leaf) {
+    return i - cells_.begin();
+  }
+  return -1;
+}
+
+bool S2PolygonClassifier::NearCellEdge(int i, S2Point const& p) const {
+  for (int k = cell_edges_begin_[i]; k < cell_edges_begin_[i + 1]; ++k) {
+    if (fabs(p.DotProd(edge_normals_[cell_edge_ids_[k]])) <=
+        kNearEdgeDistance) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool S2PolygonClassifier::CellContains(int i, S2Point const& p) const {
+  if (NearCellEdge(i, p)) return ExactContains(p);
+  int const begin = cell_edges_begin_[i];
+  return center_inside_[i] ^
+      CrossesOddEdges(cells_[i].ToPoint(), p, &cell_edge_ids_[0] + begin,
+                      cell_edges_begin_[i + 1] - begin);
+}
+
+S2PolygonClassifier::CellLocation S2PolygonClassifier::LocateCell(
+    S2Point const& p) const {
+  int const i = FindCell(S2CellId::FromPoint(p));
+  if (i < 0) return EXTERIOR;
+  return cell_edges_begin_[i] == cell_edges_begin_[i + 1] ? INTERIOR
+                                                          : BOUNDARY;
+}
+
+bool S2PolygonClassifier::Contains(S2Point const& p) const {
+  int const i = FindCell(S2CellId::FromPoint(p));
+  if (i < 0) return false;
+  // Interior cells have no edges, so this just returns true for them.
+  return CellContains(i, p);
+}
+
+struct S2PolygonClassifier::ClassifyTask {
+  S2PolygonClassifier const* classifier;
+  S2Point const* points;
+  int begin, end;    // The range of points to classify; "begin" is a
+  uint64* hits;      // multiple of 64 so that tasks don't share words.
+};
+
+void* S2PolygonClassifier::RunClassifyTask(void* arg) {
+  ClassifyTask const& task = *static_cast<ClassifyTask*>(arg);
+  for (int k = task.begin; k < task.end; ++k) {
+    if (task.classifier->Contains(task.points[k])) {
+      task.hits[k >> 6] |= uint64(1) << (k & 63);
+    }
+  }
+  return NULL;
+}
+
+void S2PolygonClassifier::ContainsPoints(S2Point const* points, int n,
+                                         vector<uint64>* hits,
+                                         int num_threads) const {
+  hits->assign((n + 63) >> 6, 0);
+  if (n == 0) return;
+  num_threads = max(1, min(num_threads, n / kMinPointsPerClassifyThread));
+  // Round the chunk size up to a multiple of 64.
+  int const chunk = ((n + num_threads - 1) / num_threads + 63) & ~63;
+  vector<ClassifyTask> tasks;
+  for (int begin = 0; begin < n; begin += chunk) {
+    ClassifyTask task = { this, points, begin, min(n, begin + chunk),
+                          &(*hits)[0] };
+    tasks.push_back(task);
+  }
+  S2RunTasks(&tasks, RunClassifyTask);
+}
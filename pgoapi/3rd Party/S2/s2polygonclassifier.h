@@ -0,0 +1,169 @@
+#ifndef UTIL_GEOMETRY_S2POLYGONCLASSIFIER_H_
+#define UTIL_GEOMETRY_S2POLYGONCLASSIFIER_H_
+
+#include <utility>
+using std::pair;
+
+#include <vector>
+using std::vector;
+
+#include "integral_types.h"
+#include "macros.h"
+#include "s2.h"
+#include "s2cellid.h"
+#include "s2latlngrect.h"
+
+class S2Cell;
+class S2Loop;
+class S2Polygon;
+
+// An S2PolygonClassifier answers S2Polygon::Contains(S2Point) for large
+// numbers of points.  When it is created it covers the polygon with cells
+// no smaller than a chosen level, and sorts them into "interior" cells,
+// which are contained by the polygon, and "boundary" cells, which some
+// polygon edge may intersect.  A point is then classified by looking up its
+// leaf cell: points in an interior cell are inside the polygon, points in
+// no cell at all are outside it, and only points in a boundary cell are
+// tested exactly, against the few polygon edges that intersect that cell.
+//
+// Finer levels send fewer points to the exact test and give each boundary
+// cell fewer edges, but take longer to build and use more cells, roughly
+// (perimeter / cell width) of them.  For example, level 16 cells are about
+// 150m across, so a 30km perimeter needs a few hundred boundary cells.  To
+// find the level for a given cell width:
+//
+//   int level = S2::kAvgEdge.GetClosestLevel(width_radians);
+//
+// Typical usage:
+//
+//   S2PolygonClassifier classifier(&polygon, 16);
+//   vector<uint64> inside;
+//   classifier.ContainsPoints(&points[0], points.size(), &inside);
+//
+// The results are the same as calling polygon.Contains() for every point.
+// The classifier copies the polygon's edges and does not refer to the
+// polygon after it has been created.  All methods are const and may be
+// called concurrently from any number of threads.
+class S2PolygonClassifier {
+ public:
+  // Builds a classifier for "polygon" using cells of at most "max_level".
+  // This takes time proportional to the number of polygon edges times the
+  // number of levels, plus six brute force point containment tests, one
+  // for the center of each cube face.
+  S2PolygonClassifier(S2Polygon const* polygon, int max_level);
+
+  // Builds a classifier for a single loop, which answers
+  // S2Loop::Contains(S2Point) instead.  S2Loop uses this to index its own
+  // point queries.
+  S2PolygonClassifier(S2Loop const* loop, int max_level);
+
+  ~S2PolygonClassifier();
+
+  int max_level() const { return max_level_; }
+  int num_interior_cells() const { return num_interior_cells_; }
+  int num_boundary_cells() const {
+    return cells_.size() - num_interior_cells_;
+  }
+
+  // Where the leaf cell of a point lies relative to the classifier's cells.
+  enum CellLocation { EXTERIOR, BOUNDARY, INTERIOR };
+
+  // Looks up the leaf cell containing "p" without testing any edges.  The
+  // polygon contains no EXTERIOR points and all INTERIOR points; BOUNDARY
+  // points need an exact test.
+  CellLocation LocateCell(S2Point const& p) const;
+
+  // Returns true if the polygon contains the given point.
+  bool Contains(S2Point const& p) const;
+
+  // Batch version of Contains().  Resizes "hits" to (n + 63) / 64 words and
+  // sets bit (k % 64) of (*hits)[k / 64] if the polygon contains the k-th
+  // point, and clears it otherwise.  If "num_threads" > 1, large batches are
+  // split into up to that many contiguous chunks that are classified
+  // concurrently.
+  void ContainsPoints(S2Point const* points, int n, vector<uint64>* hits,
+                      int num_threads = 1) const;
+
+ private:
+  // Copies the edges of the given loops and finds the cells.  The polygon
+  // is the symmetric difference of the loops.
+  void Init(vector<S2Loop const*> const& loops);
+
+  // Returns true if the polygon contains "p", testing every edge in the
+  // same way as S2Loop::ContainsByCrossings().
+  bool ExactContains(S2Point const& p) const;
+
+  // Sets "root" to the smallest cell that contains every vertex, and returns
+  // true if no vertex is in a leaf cell on the boundary of that cell.
+  bool FindRootCell(S2CellId* root) const;
+
+  // Adds the cells within "id", given that every edge is within "root", the
+  // polygon contains the center of "root" if "root_inside" is true, and
+  // contains every point outside "root" if "outside_inside" is true.
+  void AddCellsAround(S2CellId const& id, S2CellId const& root,
+                      bool root_inside, bool outside_inside,
+                      vector<int> const& all_edges);
+
+  // Appends a cell with the given edges to cells_.
+  void AddCell(S2CellId const& id, bool center_inside,
+               vector<int> const& edges);
+
+  // Adds the interior and boundary cells within "cell", in sorted order.
+  // "parent_edges" contains every edge that may intersect the cell.
+  void AddCells(S2Cell const& cell, bool center_inside,
+                vector<int> const& parent_edges);
+
+  // Returns true if edge "e" may intersect the region of "face" whose
+  // (u,v)-coordinates are within "uv", and whose vertices are "v".  Edges
+  // that only touch the region are included.
+  bool EdgeMayIntersect(int face, double const uv[2][2], S2Point const v[4],
+                        int e) const;
+
+  // Returns true if the segment AB crosses an odd number of the given
+  // edges, counted with S2EdgeUtil::EdgeOrVertexCrossing().
+  bool CrossesOddEdges(S2Point const& a, S2Point const& b,
+                       int const* edge_ids, int num_edges) const;
+
+  // Returns the index in cells_ of the cell containing "leaf", or -1 if no
+  // cell contains it.
+  int FindCell(S2CellId const& leaf) const;
+
+  // Returns true if the polygon contains "p", which is in cells_[i].
+  bool CellContains(int i, S2Point const& p) const;
+
+  // Returns true if "p" is so close to the great circle through one of the
+  // edges of cells_[i] that CellContains() must use ExactContains().
+  bool NearCellEdge(int i, S2Point const& p) const;
+
+  struct ClassifyTask;
+  static void* RunClassifyTask(void* arg);
+
+  int max_level_;
+
+  // The interior and boundary cells together, sorted and disjoint.
+  vector<S2CellId> cells_;
+
+  // The edges that may intersect cells_[i] are
+  // edges_[cell_edge_ids_[k]] for k in [cell_edges_begin_[i],
+  // cell_edges_begin_[i + 1]); interior cells have none.  center_inside_[i]
+  // is true if the polygon contains the center of cells_[i].
+  // edge_normals_[e] is the unit normal of the great circle through
+  // edges_[e].
+  vector<pair<S2Point, S2Point> > edges_;
+  vector<S2Point> edge_normals_;
+  vector<int> cell_edge_ids_;
+  vector<int> cell_edges_begin_;
+  vector<bool> center_inside_;
+  int num_interior_cells_;
+
+  // The edges of loop k are edges_[loop_edges_begin_[k]] up to
+  // edges_[loop_edges_begin_[k + 1]], in order, and loop_bounds_[k] and
+  // loop_origin_inside_[k] are the loop's bound and origin_inside_.
+  vector<int> loop_edges_begin_;
+  vector<S2LatLngRect> loop_bounds_;
+  vector<bool> loop_origin_inside_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(S2PolygonClassifier);
+};
+
+#endif  // UTIL_GEOMETRY_S2POLYGONCLASSIFIER_H_
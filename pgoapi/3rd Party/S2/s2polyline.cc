@@ -1,5 +1,10 @@
 // Copyright 2005 Google Inc. All Rights Reserved.
 
+#include <algorithm>
+using std::max;
+using std::min;
+using std::min_element;
+
 #include <set>
 using std::set;
 using std::multiset;
@@ -17,11 +22,22 @@ using std::vector;
 #include "s2cell.h"
 #include "s2latlng.h"
 #include "s2edgeutil.h"
+#include "s2pointcolumns.h"
 
 DECLARE_bool(s2debug);  // defined in s2.cc
 
 static const unsigned char kCurrentEncodingVersionNumber = 1;
 
+// Polylines with at least this many vertices keep a structure-of-arrays copy
+// of their vertices.
+static int const kMinVerticesForColumns = 64;
+
+// Project() skips an edge only if it is provably this much farther away
+// than the closest edge found so far.  This is far more than the rounding
+// error of S2EdgeUtil::GetDistance(), which is largest (about 3e-8) for
+// distances near Pi/2.
+static double const kMinSkippedEdgeMargin = 1e-6;
+
 S2Polyline::S2Polyline()
   : num_vertices_(0),
     vertices_(NULL) {
@@ -53,6 +69,7 @@ void S2Polyline::Init(vector<S2Point> const& vertices) {
   if (num_vertices_ > 0) {
     memcpy(vertices_, &vertices[0], num_vertices_ * sizeof(vertices_[0]));
   }
+  InitColumns();
 }
 
 void S2Polyline::Init(vector<S2LatLng> const& vertices) {
@@ -62,6 +79,7 @@ void S2Polyline::Init(vector<S2LatLng> const& vertices) {
   for (int i = 0; i < num_vertices_; ++i) {
     vertices_[i] = vertices[i].ToPoint();
   }
+  InitColumns();
   if (FLAGS_s2debug) {
     vector<S2Point> vertex_vector(vertices_, vertices_ + num_vertices_);
     CHECK(IsValid(vertex_vector));
@@ -94,14 +112,42 @@ S2Polyline::S2Polyline(S2Polyline const* src)
   : num_vertices_(src->num_vertices_),
     vertices_(new S2Point[num_vertices_]) {
   memcpy(vertices_, src->vertices_, num_vertices_ * sizeof(vertices_[0]));
+  InitColumns();
 }
 
 S2Polyline* S2Polyline::Clone() const {
   return new S2Polyline(this);
 }
 
+void S2Polyline::InitColumns() {
+  columns_.reset();
+  edge_chords_.clear();
+  if (num_vertices_ < kMinVerticesForColumns) return;
+  columns_.reset(new S2PointColumns(vertices_, num_vertices_));
+  edge_chords_.resize(num_vertices_ - 1);
+  for (int i = 0; i + 1 < num_vertices_; ++i) {
+    edge_chords_[i] = (vertices_[i] - vertices_[i + 1]).Norm();
+  }
+}
+
 S1Angle S2Polyline::GetLength() const {
   S1Angle length;
+  if (columns_.get() != NULL) {
+    // This sums the same angles as the loop below, but the cross and dot
+    // products are vectorized, in blocks that stay in the L1 cache.  Only
+    // sqrt() and atan2() are left per edge.
+    static int const kBlockSize = 64;
+    double cross2[kBlockSize], dot[kBlockSize];
+    int const num_edges = num_vertices() - 1;
+    for (int begin = 0; begin < num_edges; begin += kBlockSize) {
+      int const end = min(num_edges, begin + kBlockSize);
+      columns_->GetChainProducts(begin, end, cross2, dot);
+      for (int i = 0; i < end - begin; ++i) {
+        length += S1Angle::Radians(atan2(sqrt(cross2[i]), dot[i]));
+      }
+    }
+    return length;
+  }
   for (int i = 1; i < num_vertices(); ++i) {
     length += S1Angle(vertex(i-1), vertex(i));
   }
@@ -178,28 +224,73 @@ double S2Polyline::UnInterpolate(S2Point const& point, int next_vertex) const {
   return min(1.0, length_to_point / length_sum);
 }
 
-S2Point S2Polyline::Project(S2Point const& point, int* next_vertex) const {
-  DCHECK_GT(num_vertices(), 0);
-
-  if (num_vertices() == 1) {
-    // If there is only one vertex, it is always closest to any given point.
-    *next_vertex = 1;
-    return vertex(0);
-  }
+// Returns the chord length of an angle slightly larger than "distance", or
+// 4 (more than any chord) if that angle is too close to Pi for its chord to
+// bound the angle accurately.
+static double GetSkipChord(S1Angle const& distance) {
+  double const radians = distance.radians() + kMinSkippedEdgeMargin;
+  return radians < 3 ? 2 * sin(0.5 * radians) : 4;
+}
 
+int S2Polyline::FindClosestEdge(S2Point const& point) const {
   // Initial value larger than any possible distance on the unit sphere.
   S1Angle min_distance = S1Angle::Radians(10);
   int min_index = -1;
+  if (columns_.get() == NULL) {
+    for (int i = 1; i < num_vertices(); ++i) {
+      S1Angle distance_to_segment = S2EdgeUtil::GetDistance(point, vertex(i-1),
+                                                            vertex(i));
+      if (distance_to_segment < min_distance) {
+        min_distance = distance_to_segment;
+        min_index = i;
+      }
+    }
+    return min_index;
+  }
 
-  // Find the line segment in the polyline that is closest to the point given.
+  // Every point of the edge AB is within the chord |A - B| of both A and B,
+  // so its chord distance from "point" is at least max(|point - A|,
+  // |point - B|) - |A - B|.  Edges for which this exceeds the chord of the
+  // closest distance found so far (plus a margin) are skipped without
+  // calling GetDistance().  Starting from an edge at the closest vertex
+  // makes that distance small from the beginning.  The result is the same
+  // as testing every edge in order.
+  vector<double> dist2(columns_->padded_size());
+  columns_->GetDistances2(point, &dist2[0]);
+  int const closest_vertex =
+      min_element(dist2.begin(), dist2.begin() + num_vertices()) -
+      dist2.begin();
+  int const first = max(1, closest_vertex);
+  min_distance = S2EdgeUtil::GetDistance(point, vertex(first-1),
+                                         vertex(first));
+  min_index = first;
+  double skip_chord = GetSkipChord(min_distance);
   for (int i = 1; i < num_vertices(); ++i) {
+    double const reach = skip_chord + edge_chords_[i-1];
+    if (i == first || max(dist2[i-1], dist2[i]) > reach * reach) continue;
     S1Angle distance_to_segment = S2EdgeUtil::GetDistance(point, vertex(i-1),
                                                           vertex(i));
-    if (distance_to_segment < min_distance) {
+    if (distance_to_segment < min_distance ||
+        (distance_to_segment == min_distance && i < min_index)) {
       min_distance = distance_to_segment;
       min_index = i;
+      skip_chord = GetSkipChord(min_distance);
     }
   }
+  return min_index;
+}
+
+S2Point S2Polyline::Project(S2Point const& point, int* next_vertex) const {
+  DCHECK_GT(num_vertices(), 0);
+
+  if (num_vertices() == 1) {
+    // If there is only one vertex, it is always closest to any given point.
+    *next_vertex = 1;
+    return vertex(0);
+  }
+
+  // Find the line segment in the polyline that is closest to the point given.
+  int min_index = FindClosestEdge(point);
   DCHECK_NE(min_index, -1);
 
   // Compute the point on the segment found that is closest to the point given.
@@ -239,7 +330,8 @@ bool S2Polyline::IsOnRight(S2Point const& point) const {
 }
 
 bool S2Polyline::Intersects(S2Polyline const* line) const {
-  if (num_vertices() <= 0 || line->num_vertices() <= 0) {
+  // A polyline with fewer than two vertices has no edges to cross.
+  if (num_vertices() < 2 || line->num_vertices() < 2) {
     return false;
   }
 
@@ -251,10 +343,9 @@ bool S2Polyline::Intersects(S2Polyline const* line) const {
   for (int i = 1; i < num_vertices(); ++i) {
     S2EdgeUtil::EdgeCrosser crosser(
         &vertex(i - 1), &vertex(i), &line->vertex(0));
-    for (int j = 1; j < line->num_vertices(); ++j) {
-      if (crosser.RobustCrossing(&line->vertex(j)) >= 0) {
-        return true;
-      }
+    if (crosser.FindRobustCrossing(&line->vertex(1),
+                                   line->num_vertices() - 1) >= 0) {
+      return true;
     }
   }
   return false;
@@ -262,6 +353,7 @@ bool S2Polyline::Intersects(S2Polyline const* line) const {
 
 void S2Polyline::Reverse() {
   reverse(vertices_, vertices_ + num_vertices_);
+  InitColumns();
 }
 
 S2LatLngRect S2Polyline::GetRectBound() const {
@@ -320,6 +412,7 @@ bool S2Polyline::Decode(Decoder* const decoder) {
   delete[] vertices_;
   vertices_ = new S2Point[num_vertices_];
   decoder->getn(vertices_, num_vertices_ * sizeof(*vertices_));
+  InitColumns();
 
   if (FLAGS_s2debug) {
     vector<S2Point> vertex_vector(vertices_, vertices_ + num_vertices_);
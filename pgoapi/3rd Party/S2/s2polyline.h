@@ -11,8 +11,10 @@ using std::vector;
 #include "s2.h"
 #include "s2region.h"
 #include "s2latlngrect.h"
+#include "scoped_ptr.h"
 
 class S1Angle;
+class S2PointColumns;
 
 // An S2Polyline represents a sequence of zero or more vertices connected by
 // straight edges (geodesics).  Edges of length 0 and 180 degrees are not
@@ -182,12 +184,27 @@ class S2Polyline : public S2Region {
   // its argument.
   S2Polyline(S2Polyline const* src);
 
+  // Rebuilds columns_ and edge_chords_ after the vertices have changed.
+  void InitColumns();
+
+  // Returns the index i of the edge (vertex(i-1), vertex(i)) that is closest
+  // to "point", or the first such edge if several are equally close.
+  int FindClosestEdge(S2Point const& point) const;
+
   // We store the vertices in an array rather than a vector because we don't
   // need any STL methods, and computing the number of vertices using size()
   // would be relatively expensive (due to division by sizeof(S2Point) == 24).
   int num_vertices_;
   S2Point* vertices_;
 
+  // Polylines with many vertices also keep a structure-of-arrays copy of
+  // the vertices, which lets GetLength() and Project() process several
+  // vertices per instruction, and the chord length of each edge:
+  // edge_chords_[i] is (vertex(i) - vertex(i+1)).Norm().  Shorter polylines
+  // leave columns_ NULL and edge_chords_ empty.
+  scoped_ptr<S2PointColumns> columns_;
+  vector<double> edge_chords_;
+
   DISALLOW_EVIL_CONSTRUCTORS(S2Polyline);
 };
 
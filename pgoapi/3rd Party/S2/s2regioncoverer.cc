@@ -2,13 +2,14 @@
 
 #include "s2regioncoverer.h"
 
-#include <pthread.h>
+#include <new>
 
 #include <algorithm>
 using std::min;
 using std::max;
 using std::swap;
 using std::reverse;
+using std::sort;
 
 #include <functional>
 using std::less;
@@ -46,18 +47,57 @@ struct S2RegionCoverer::CompareQueueEntries : public less<QueueEntry> {
   }
 };
 
-static S2Cell face_cells[6];
+// Candidates are carved out of fixed-size blocks.  The largest candidate
+// (level_mod == 3) needs sizeof(Candidate) plus 64 child pointers, which fits
+// comfortably in a block.
+class S2RegionCoverer::CandidateArena {
+ public:
+  CandidateArena() : block_(0), used_(kBlockSize), bytes_allocated_(0) {}
 
-void Init() {
-  for (int face = 0; face < 6; ++face) {
-    face_cells[face] = S2Cell::FromFacePosLevel(face, 0, 0);
+  ~CandidateArena() {
+    for (int i = 0; i < blocks_.size(); ++i) free(blocks_[i]);
   }
-}
 
-static pthread_once_t init_once = PTHREAD_ONCE_INIT;
-inline static void MaybeInit() {
-  pthread_once(&init_once, Init);
-}
+  // Return "size" bytes of uninitialized storage aligned to kAlignment.
+  void* Alloc(size_t size) {
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    DCHECK_LE(size, kBlockSize);
+    if (used_ + size > kBlockSize) {
+      if (blocks_.empty() || block_ + 1 == blocks_.size()) {
+        blocks_.push_back(static_cast<char*>(malloc(kBlockSize)));
+        block_ = blocks_.size() - 1;
+      } else {
+        ++block_;
+      }
+      used_ = 0;
+    }
+    void* result = blocks_[block_] + used_;
+    used_ += size;
+    bytes_allocated_ += size;
+    return result;
+  }
+
+  // Make all the storage available again without returning it to the heap.
+  void Reset() {
+    block_ = 0;
+    used_ = blocks_.empty() ? kBlockSize : 0;
+    bytes_allocated_ = 0;
+  }
+
+  size_t bytes_allocated() const { return bytes_allocated_; }
+  size_t bytes_reserved() const { return blocks_.size() * kBlockSize; }
+
+ private:
+  static size_t const kBlockSize = 16 << 10;
+  static size_t const kAlignment = 8;
+
+  vector<char*> blocks_;
+  int block_;                // Index of the block currently being filled.
+  size_t used_;              // Bytes used in blocks_[block_].
+  size_t bytes_allocated_;   // Bytes handed out since the last Reset().
+
+  DISALLOW_EVIL_CONSTRUCTORS(CandidateArena);
+};
 
 S2RegionCoverer::S2RegionCoverer() :
   min_level_(0),
@@ -66,9 +106,10 @@ S2RegionCoverer::S2RegionCoverer() :
   max_cells_(kDefaultMaxCells),
   region_(NULL),
   result_(new vector<S2CellId>),
-  pq_(new CandidateQueue) {
-  // Initialize the constants
-  MaybeInit();
+  normalized_(new S2CellUnion),
+  pq_(new CandidateQueue),
+  arena_(new CandidateArena),
+  candidates_created_counter_(0) {
 }
 
 S2RegionCoverer::~S2RegionCoverer() {
@@ -118,21 +159,22 @@ S2RegionCoverer::Candidate* S2RegionCoverer::NewCandidate(S2Cell const& cell) {
   if (!is_terminal) {
     size += sizeof(Candidate*) << max_children_shift();
   }
-  Candidate* candidate = static_cast<Candidate*>(malloc(size));
-  memset(candidate, 0, size);
+  // The children array is left uninitialized; only the first num_children
+  // entries are ever read.
+  Candidate* candidate = new (arena_->Alloc(size)) Candidate;
   candidate->cell = cell;
   candidate->is_terminal = is_terminal;
+  candidate->num_children = 0;
   ++candidates_created_counter_;
   return candidate;
 }
 
-void S2RegionCoverer::DeleteCandidate(Candidate* candidate,
-                                      bool delete_children) {
-  if (delete_children) {
-    for (int i = 0; i < candidate->num_children; ++i)
-      DeleteCandidate(candidate->children[i], true);
-  }
-  free(candidate);
+size_t S2RegionCoverer::candidate_bytes_allocated() const {
+  return arena_->bytes_allocated();
+}
+
+size_t S2RegionCoverer::candidate_bytes_reserved() const {
+  return arena_->bytes_reserved();
 }
 
 int S2RegionCoverer::ExpandChildren(Candidate* candidate,
@@ -162,7 +204,6 @@ void S2RegionCoverer::AddCandidate(Candidate* candidate) {
 
   if (candidate->is_terminal) {
     result_->push_back(candidate->cell.id());
-    DeleteCandidate(candidate, true);
     return;
   }
   DCHECK_EQ(0, candidate->num_children);
@@ -173,7 +214,7 @@ void S2RegionCoverer::AddCandidate(Candidate* candidate) {
   int num_terminals = ExpandChildren(candidate, candidate->cell, num_levels);
 
   if (candidate->num_children == 0) {
-    DeleteCandidate(candidate, false);
+    // Drop the candidate; its storage is reclaimed when the arena is reset.
 
   } else if (!interior_covering_ &&
              num_terminals == 1 << max_children_shift() &&
@@ -219,19 +260,18 @@ void S2RegionCoverer::GetInitialCandidates() {
     if (level > 0) {
       // Find the leaf cell containing the cap axis, and determine which
       // subcell of the parent cell contains it.
-      vector<S2CellId> base;
-      base.reserve(4);
+      initial_cells_.clear();
       S2CellId id = S2CellId::FromPoint(cap.axis());
-      id.AppendVertexNeighbors(level, &base);
-      for (int i = 0; i < base.size(); ++i) {
-        AddCandidate(NewCandidate(S2Cell(base[i])));
+      id.AppendVertexNeighbors(level, &initial_cells_);
+      for (int i = 0; i < initial_cells_.size(); ++i) {
+        AddCandidate(NewCandidate(S2Cell(initial_cells_[i])));
       }
       return;
     }
   }
   // Default: start with all six cube faces.
   for (int face = 0; face < 6; ++face) {
-    AddCandidate(NewCandidate(face_cells[face]));
+    AddCandidate(NewCandidate(S2Cell::FromFacePosLevel(face, 0, 0)));
   }
 }
 
@@ -254,6 +294,7 @@ void S2RegionCoverer::GetCoveringInternal(S2Region const& region) {
   DCHECK(result_->empty());
   region_ = &region;
   candidates_created_counter_ = 0;
+  arena_->Reset();
 
   GetInitialCandidates();
   while (!pq_->empty() &&
@@ -269,19 +310,16 @@ void S2RegionCoverer::GetCoveringInternal(S2Region const& region) {
       for (int i = 0; i < candidate->num_children; ++i) {
         AddCandidate(candidate->children[i]);
       }
-      DeleteCandidate(candidate, false);
-    } else if (interior_covering_) {
-      DeleteCandidate(candidate, true);
-    } else {
+    } else if (!interior_covering_) {
       candidate->is_terminal = true;
       AddCandidate(candidate);
     }
+    // Otherwise the candidate is simply dropped (interior coverings only).
   }
   VLOG(2) << "Created " << result_->size() << " cells, " <<
       candidates_created_counter_ << " candidates created, " <<
-      pq_->size() << " left";
+      arena_->bytes_allocated() << " bytes, " << pq_->size() << " left";
   while (!pq_->empty()) {
-    DeleteCandidate(pq_->top().second, true);
     pq_->pop();
   }
   region_ = NULL;
@@ -298,16 +336,224 @@ void S2RegionCoverer::GetCovering(S2Region const& region,
   // number of cells returned in many cases, and it is cheap compared to
   // computing the covering in the first place.
 
-  S2CellUnion tmp;
-  GetCellUnion(region, &tmp);
-  tmp.Denormalize(min_level(), level_mod(), covering);
+  GetCellUnion(region, normalized_.get());
+  normalized_->Denormalize(min_level(), level_mod(), covering);
+}
+
+// Vertex classifications used by GetCapCovering().
+enum { kFarVertex = 0, kNearVertex = 1, kInsideVertex = 2 };
+
+// Classify the cell vertex at the given (u,v)-coordinate "v" and
+// i-coordinate "i" on the given face.  The vertex is computed exactly as
+// S2Cell::GetVertex() does so that kInsideVertex agrees with
+// S2Cap::MayIntersect().
+static inline uint8 ClassifyVertex(S2Cap const& cap, double near_norm2,
+                                   int face, int i, double v) {
+  double u = S2::STtoUV((1.0 / S2CellId::kMaxSize) * i);
+  S2Point p = S2::FaceUVtoXYZ(face, u, v).Normalize();
+  if (cap.Contains(p)) return kInsideVertex;
+  if ((cap.axis() - p).Norm2() <= near_norm2) return kNearVertex;
+  return kFarVertex;
+}
+
+void S2RegionCoverer::GetCapCovering(S2Cap const& cap,
+                                     vector<S2CellId>* covering) {
+  // When min_level() == max_level(), every candidate above that level is
+  // expanded and every candidate at that level is terminal, so GetCovering()
+  // returns all the cells at that level that descend from the initial
+  // candidates and intersect the cap (max_cells() has no effect).  Here we
+  // compute the same set by scanning the block of (i,j)-space spanned by the
+  // initial candidates, clipped to the cells that are close enough to the
+  // cap axis to intersect the cap.
+  int const level = max_level();
+  if (min_level() != level || max_cells() < 4 ||
+      cap.is_empty() || cap.is_full()) {
+    GetCovering(cap, covering);
+    return;
+  }
+  // This must match the level chosen by GetInitialCandidates().
+  int initial_level = min(S2::kMinWidth.GetMaxLevel(2 * cap.angle().radians()),
+                          min(level, S2CellId::kMaxLevel - 1));
+  if (initial_level <= 0) {
+    GetCovering(cap, covering);
+    return;
+  }
+  S2CellId axis_id = S2CellId::FromPoint(cap.axis());
+  initial_cells_.clear();
+  axis_id.AppendVertexNeighbors(initial_level, &initial_cells_);
+
+  int const face = initial_cells_[0].face();
+  int const initial_size = S2CellId::GetSizeIJ(initial_level);
+  int i_lo = S2CellId::kMaxSize, i_hi = 0;
+  int j_lo = S2CellId::kMaxSize, j_hi = 0;
+  for (int k = 0; k < initial_cells_.size(); ++k) {
+    if (initial_cells_[k].face() != face) {
+      GetCovering(cap, covering);
+      return;
+    }
+    int i, j;
+    initial_cells_[k].ToFaceIJOrientation(&i, &j, NULL);
+    i &= -initial_size;
+    j &= -initial_size;
+    i_lo = min(i_lo, i);
+    i_hi = max(i_hi, i + initial_size);
+    j_lo = min(j_lo, j);
+    j_hi = max(j_hi, j + initial_size);
+  }
+
+  // Any cell that intersects the cap is within this many cells of the cell
+  // containing the axis (in both i and j), since every cell in between is at
+  // least kMinWidth wide.  Two extra cells are allowed for rounding.
+  int const size = S2CellId::GetSizeIJ(level);
+  int const reach = size * (2 + static_cast<int>(
+      cap.angle().radians() / S2::kMinWidth.GetValue(level)));
+  int axis_i, axis_j;
+  axis_id.ToFaceIJOrientation(&axis_i, &axis_j, NULL);
+  axis_i &= -size;
+  axis_j &= -size;
+  i_lo = max(i_lo, axis_i - reach);
+  i_hi = min(i_hi, axis_i + size + reach);
+  j_lo = max(j_lo, axis_j - reach);
+  j_hi = min(j_hi, axis_j + size + reach);
+
+  // If a cell intersects the cap but none of its vertices are inside it,
+  // then either the cell contains the cap axis or the cap crosses one of its
+  // edges at a point within the cap angle of the axis.  In the latter case
+  // one of the cell vertices is within (cap angle + kMaxEdge / 2) of the
+  // axis.  The bound is padded slightly so that rounding errors cannot
+  // exclude a cell that MayIntersect() would accept.
+  double near_angle = cap.angle().radians() +
+                      0.51 * S2::kMaxEdge.GetValue(level);
+  double near_norm2 = 4;
+  if (near_angle < M_PI) {
+    double sin_half = sin(0.5 * near_angle);
+    near_norm2 = 4 * sin_half * sin_half;
+  }
+
+  // Each cell vertex is classified as inside the cap, near it or far from
+  // it.  A cell with a vertex inside the cap is accepted immediately (this
+  // is the first thing S2Cap::MayIntersect() checks, using the same vertex
+  // computation), and the cells along the cap boundary as well as the cell
+  // containing the axis are tested exactly.  All other cells are rejected.
+  //
+  // Each row of vertices lies on a great circle, so the near vertices of a
+  // row form a contiguous range.  We classify outwards from the axis column
+  // and stop at the first far vertex in each direction.  Similarly the rows
+  // that have near vertices are contiguous, so the scan stops at the first
+  // row past the cap.
+  int const num_cols = (i_hi - i_lo) / size;
+  int const num_rows = (j_hi - j_lo) / size;
+  int const axis_col = (axis_i - i_lo) / size;
+  vertex_states_.resize(2 * (num_cols + 1));
+  covering->clear();
+  bool seen_near_row = false;
+  for (int row = 0; row <= num_rows; ++row) {
+    uint8* states = &vertex_states_[(row & 1) * (num_cols + 1)];
+    memset(states, kFarVertex, num_cols + 1);
+    double v = S2::STtoUV((1.0 / S2CellId::kMaxSize) * (j_lo + row * size));
+    states[axis_col] = ClassifyVertex(cap, near_norm2, face,
+                                      i_lo + axis_col * size, v);
+    if (states[axis_col] == kFarVertex) {
+      // The near range (if any) is shorter than one cell, so scan the row.
+      for (int col = 0; col <= num_cols; ++col) {
+        states[col] = ClassifyVertex(cap, near_norm2, face,
+                                     i_lo + col * size, v);
+      }
+    } else {
+      for (int col = axis_col - 1; col >= 0; --col) {
+        states[col] = ClassifyVertex(cap, near_norm2, face,
+                                     i_lo + col * size, v);
+        if (states[col] == kFarVertex) break;
+      }
+      for (int col = axis_col + 1; col <= num_cols; ++col) {
+        states[col] = ClassifyVertex(cap, near_norm2, face,
+                                     i_lo + col * size, v);
+        if (states[col] == kFarVertex) break;
+      }
+    }
+    bool row_is_far = true;
+    for (int col = 0; col <= num_cols; ++col) {
+      if (states[col] != kFarVertex) row_is_far = false;
+    }
+    if (row > 0) {
+      uint8 const* prev = &vertex_states_[((row - 1) & 1) * (num_cols + 1)];
+      int const j = j_lo + (row - 1) * size;
+      for (int col = 0; col < num_cols; ++col) {
+        int state = max(max(prev[col], prev[col + 1]),
+                        max(states[col], states[col + 1]));
+        int const i = i_lo + col * size;
+        if (state == kFarVertex && (i != axis_i || j != axis_j)) continue;
+        S2CellId id = S2CellId::FromFaceIJ(face, i, j).parent(level);
+        if (state == kInsideVertex || cap.MayIntersect(S2Cell(id))) {
+          covering->push_back(id);
+        }
+      }
+    }
+    if (row_is_far) {
+      if (seen_near_row && j_lo + row * size > axis_j) break;
+    } else {
+      seen_near_row = true;
+    }
+  }
+  sort(covering->begin(), covering->end());
+}
+
+// Returns true if "cells" is sorted and every cell is at the given level.
+static bool IsSortedAtLevel(vector<S2CellId> const& cells, int level) {
+  for (int i = 0; i < cells.size(); ++i) {
+    if (cells[i].level() != level) return false;
+    if (i > 0 && cells[i] <= cells[i - 1]) return false;
+  }
+  return true;
+}
+
+void S2RegionCoverer::GetCapCoveringDelta(S2Cap const& cap,
+                                          vector<S2CellId> const& previous,
+                                          vector<S2CellId>* covering,
+                                          vector<S2CellId>* added,
+                                          vector<S2CellId>* removed) {
+  DCHECK_NE(&previous, covering);
+  GetCapCovering(cap, covering);
+  added->clear();
+  removed->clear();
+
+  if (min_level() == max_level() && IsSortedAtLevel(previous, max_level())) {
+    // Both coverings are sorted lists of disjoint cells at the same level, so
+    // the cells that were added or removed can be found with a single merge.
+    // This is the common case for clients that poll a fixed-level covering.
+    vector<S2CellId> const& current = *covering;
+    vector<S2CellId>::const_iterator x = current.begin();
+    vector<S2CellId>::const_iterator y = previous.begin();
+    while (x != current.end() && y != previous.end()) {
+      if (*x < *y) {
+        added->push_back(*x++);
+      } else if (*y < *x) {
+        removed->push_back(*y++);
+      } else {
+        ++x;
+        ++y;
+      }
+    }
+    added->insert(added->end(), x, current.end());
+    removed->insert(removed->end(), y, previous.end());
+    return;
+  }
+
+  // Otherwise the coverings may contain nested cells of different sizes, so
+  // compute the differences of the corresponding normalized cell unions.
+  S2CellUnion x, y, difference;
+  x.Init(*covering);
+  y.Init(previous);
+  difference.GetDifference(&x, &y);
+  difference.Detach(added);
+  difference.GetDifference(&y, &x);
+  difference.Detach(removed);
 }
 
 void S2RegionCoverer::GetInteriorCovering(S2Region const& region,
                                           vector<S2CellId>* interior) {
-  S2CellUnion tmp;
-  GetInteriorCellUnion(region, &tmp);
-  tmp.Denormalize(min_level(), level_mod(), interior);
+  GetInteriorCellUnion(region, normalized_.get());
+  normalized_->Denormalize(min_level(), level_mod(), interior);
 }
 
 void S2RegionCoverer::GetCellUnion(S2Region const& region,
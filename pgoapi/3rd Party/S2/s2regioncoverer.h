@@ -18,6 +18,7 @@ using std::vector;
 #include "s2cell.h"
 #include "s2cellid.h"
 
+class S2Cap;
 class S2CellUnion;
 
 // An S2RegionCoverer is a class that allows arbitrary regions to be
@@ -115,9 +116,49 @@ class S2RegionCoverer {
   // Return a vector of cell ids that covers (GetCovering) or is contained
   // within (GetInteriorCovering) the given region and satisfies the various
   // restrictions specified above.
+  //
+  // All of the coverer's temporary storage (candidates, the priority queue,
+  // and the cell union used for normalization) is kept between calls.  When
+  // the same coverer and output vector are reused for regions of similar
+  // size, these methods do not allocate any memory once warmed up.  Note
+  // that a coverer must not be used by more than one thread at a time.
   void GetCovering(S2Region const& region, vector<S2CellId>* covering);
   void GetInteriorCovering(S2Region const& region, vector<S2CellId>* interior);
 
+  // Returns exactly the same cells as GetCovering(cap, covering), but is
+  // much faster when min_level() == max_level().  In that case the covering
+  // is simply every cell at that level which intersects the cap, so rather
+  // than refining candidates from the top down, the cells near the cap are
+  // enumerated directly in (i,j)-space and only the ones near the cap
+  // boundary are tested exactly.  Falls back to GetCovering() if the levels
+  // differ or the cells of interest span more than one cube face.
+  void GetCapCovering(S2Cap const& cap, vector<S2CellId>* covering);
+
+  // Sets "covering" to GetCapCovering(cap, covering), and "added" and
+  // "removed" to the regions that it covers but "previous" does not, and
+  // vice versa.  This is intended for clients whose query cap moves, e.g. a
+  // location that is tracked over time: only the cells that changed need to
+  // be requested or discarded.  When min_level() == max_level() and
+  // "previous" is a covering at that level, the cells are compared with a
+  // single linear merge and "added" and "removed" consist of whole covering
+  // cells.  Otherwise they are computed with S2CellUnion::GetDifference().
+  // "covering" must not alias "previous"; all outputs are sorted.
+  //
+  // The new covering is always computed from scratch rather than by
+  // updating "previous".  Every cell of the new covering has to be tested
+  // against the new cap whether or not it was covered before, and
+  // GetCapCovering() already uses the cheapest test there is: it classifies
+  // cell vertices and only tests cells along the cap boundary exactly.  For
+  // a 1500m cap at level 15 (about 130 cells), GetCapCovering() takes about
+  // 16us, while just testing the previous cells with S2Cap::MayIntersect()
+  // takes about 9us before any gained cells have been found.  The merge
+  // itself is lost in the noise: BM_GetCapCoveringDelta takes 13-16us per
+  // step for both 10m and 100m steps.
+  void GetCapCoveringDelta(S2Cap const& cap, vector<S2CellId> const& previous,
+                           vector<S2CellId>* covering,
+                           vector<S2CellId>* added,
+                           vector<S2CellId>* removed);
+
   // Return a normalized cell union that covers (GetCellUnion) or is contained
   // within (GetInteriorCellUnion) the given region and satisfies the
   // restrictions *EXCEPT* for min_level() and level_mod().  These criteria
@@ -133,6 +174,15 @@ class S2RegionCoverer {
   static void GetSimpleCovering(S2Region const& region, S2Point const& start,
                                 int level, vector<S2CellId>* output);
 
+  // Statistics about the most recent covering computed by this object.
+  // Candidates are allocated from an arena owned by the coverer that is
+  // recycled (not freed) at the start of every covering, so once
+  // candidate_bytes_reserved() has grown large enough for the typical
+  // region no further heap allocations are made for candidates.
+  int candidates_created() const { return candidates_created_counter_; }
+  size_t candidate_bytes_allocated() const;
+  size_t candidate_bytes_reserved() const;
+
  private:
   struct Candidate {
     S2Cell cell;
@@ -141,6 +191,11 @@ class S2RegionCoverer {
     Candidate* children[0];  // Actual size may be 0, 4, 16, or 64 elements.
   };
 
+  // A bump allocator that hands out candidate storage.  Candidates are never
+  // freed individually; the whole arena is reset at the start of each
+  // covering.
+  class CandidateArena;
+
   // If the cell intersects the given region, return a new candidate with no
   // children, otherwise return NULL.  Also marks the candidate as "terminal"
   // if it should not be expanded further.
@@ -149,9 +204,6 @@ class S2RegionCoverer {
   // Return the log base 2 of the maximum number of children of a candidate.
   inline int max_children_shift() const { return 2 * level_mod_; }
 
-  // Free the memory associated with a candidate.
-  static void DeleteCandidate(Candidate* candidate, bool delete_children);
-
   // Process a candidate by either adding it to the result_ vector or
   // expanding its children and inserting it into the priority queue.
   // Passing an argument of NULL does nothing.
@@ -188,6 +240,18 @@ class S2RegionCoverer {
   // have been added to the covering so far.
   scoped_ptr<vector<S2CellId> > result_;
 
+  // Holds the normalized result_ while GetCovering() denormalizes it.  Its
+  // storage is swapped back into result_ by the next covering, so neither
+  // vector needs to be reallocated.
+  scoped_ptr<S2CellUnion> normalized_;
+
+  // Scratch space for the initial candidates of a covering.
+  vector<S2CellId> initial_cells_;
+
+  // Scratch space used by GetCapCovering() to classify two rows of cell
+  // vertices at a time.
+  vector<uint8> vertex_states_;
+
   // We keep the candidates in a priority queue.  We specify a vector to hold
   // the queue entries since for some reason priority_queue<> uses a deque by
   // default.
@@ -197,6 +261,9 @@ class S2RegionCoverer {
                          CompareQueueEntries> CandidateQueue;
   scoped_ptr<CandidateQueue> pq_;
 
+  // Storage for all the candidates created by the current covering.
+  scoped_ptr<CandidateArena> arena_;
+
   // True if we're computing an interior covering.
   bool interior_covering_;
 
@@ -8,6 +8,8 @@
 
 #import <Foundation/Foundation.h>
 
+#import "MCS2Covering.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
 /**
@@ -25,6 +27,32 @@ NS_ASSUME_NONNULL_BEGIN
                                            level:(int)level
                                     maxCellCount:(int)maxCells;
 
+/**
+ * Returns the same cells as cellIDsForRegionAtLat:long:radius:level:maxCellCount:
+ * and also the cells that were added to and removed from previousCellIDs, a
+ * covering returned by an earlier call with the same radius, level and
+ * maxCellCount. Only the changed cells need to be requested again as the
+ * location moves. This does not use the covering cache.
+ * MCS2GetCellIDDeltaForRegion returns the same cells without boxing them.
+ */
++ (NSArray<MCS2CellID *> *)cellIDsForRegionAtLat:(double)latitude
+                                            long:(double)longitude
+                                          radius:(double)radius
+                                           level:(int)level
+                                    maxCellCount:(int)maxCells
+                                 previousCellIDs:(NSArray<NSNumber *> *)previousCellIDs
+                                    addedCellIDs:(NSArray<MCS2CellID *> * _Nullable * _Nullable)addedCellIDs
+                                  removedCellIDs:(NSArray<MCS2CellID *> * _Nullable * _Nullable)removedCellIDs;
+
+/**
+ * Enables the covering cache used by cellIDsForRegionAtLat: and
+ * MCS2GetCellIDsForRegion. See MCS2EnableCoveringCache.
+ */
++ (void)enableCoveringCacheWithQuantizationLevel:(int)quantizationLevel
+                                    memoryBudget:(NSUInteger)memoryBudget;
++ (void)disableCoveringCache;
++ (MCS2CoveringCacheStatistics)coveringCacheStatistics;
+
 - (instancetype)parent;
 - (instancetype)parentForLevel:(int)level;
 - (instancetype)next;
@@ -18,7 +18,11 @@
 
 #pragma clang diagnostic pop
 
+#include <algorithm>
+#include <vector>
+
 #import "MCS2CellID.h"
+#import "MCS2Covering.h"
 
 #define EARTH_RADIUS 6371.0 * 1000.0
 
@@ -27,6 +31,7 @@
 @property (nonatomic, assign) S2CellId cellId;
 
 + (instancetype)cellIDWithWithCellId:(S2CellId)cellId;
++ (NSArray<MCS2CellID *> *)cellIDArrayWithCellIds:(uint64_t const *)cellIds count:(size_t)count;
 - (instancetype)initWithCellId:(S2CellId)cellId;
 
 @end
@@ -60,27 +65,99 @@
                                            level:(int)level
                                     maxCellCount:(int)maxCells
 {
-    S2Point axis = S2LatLng::FromDegrees(latitude, longitude).ToPoint();
-    S1Angle angle = S1Angle::Degrees(360*radius/(2.0 * M_PI * EARTH_RADIUS));
-    S2Cap cap = S2Cap::FromAxisAngle(axis, angle);
-    S2RegionCoverer coverer;
-    std::vector<S2CellId> cells;
+    uint64_t *cellIds = MCS2CopyCellIDsForRegion(latitude, longitude, radius, level, maxCells);
+    if (!cellIds)
+    {
+        return @[];
+    }
     
-    coverer.set_min_level(level);
-    coverer.set_max_level(level);
-    coverer.set_max_cells(maxCells);
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity:cellIds[0]];
+    for (uint64_t i = 1; i <= cellIds[0]; ++i)
+    {
+        [result addObject:[self cellIDWithWithCellId:S2CellId(cellIds[i])]];
+    }
+    MCS2FreeCellIDs(cellIds);
     
-    coverer.GetCovering(cap, &cells);
+    return result;
+}
+
++ (NSArray<MCS2CellID *> *)cellIDsForRegionAtLat:(double)latitude
+                                            long:(double)longitude
+                                          radius:(double)radius
+                                           level:(int)level
+                                    maxCellCount:(int)maxCells
+                                 previousCellIDs:(NSArray<NSNumber *> *)previousCellIDs
+                                    addedCellIDs:(NSArray<MCS2CellID *> * _Nullable * _Nullable)addedCellIDs
+                                  removedCellIDs:(NSArray<MCS2CellID *> * _Nullable * _Nullable)removedCellIDs
+{
+    std::vector<uint64_t> previous;
+    previous.reserve(previousCellIDs.count);
+    for (NSNumber *value in previousCellIDs)
+    {
+        previous.push_back(value.unsignedLongLongValue);
+    }
     
-    NSMutableArray *result = [NSMutableArray arrayWithCapacity:cells.size()];
-    for (auto const& value: cells)
+    // A moving location adds and removes only a few cells, so size the
+    // buffers for that and grow them if the counts say otherwise.
+    std::vector<uint64_t> cellIds(std::max(previous.size(), (size_t)maxCells));
+    std::vector<uint64_t> added(maxCells);
+    std::vector<uint64_t> removed(maxCells);
+    MCS2CellIDDeltaCounts counts;
+    while (true)
     {
-        [result addObject:[self cellIDWithWithCellId:value]];
+        counts = MCS2GetCellIDDeltaForRegion(latitude, longitude, radius, level, maxCells,
+                                             previous.data(), previous.size(),
+                                             cellIds.data(), cellIds.size(),
+                                             added.data(), added.size(),
+                                             removed.data(), removed.size());
+        if (counts.cellCount <= cellIds.size() &&
+            counts.addedCount <= added.size() &&
+            counts.removedCount <= removed.size())
+        {
+            break;
+        }
+        cellIds.resize(std::max(cellIds.size(), counts.cellCount));
+        added.resize(std::max(added.size(), counts.addedCount));
+        removed.resize(std::max(removed.size(), counts.removedCount));
     }
     
+    if (addedCellIDs)
+    {
+        *addedCellIDs = [self cellIDArrayWithCellIds:added.data() count:counts.addedCount];
+    }
+    if (removedCellIDs)
+    {
+        *removedCellIDs = [self cellIDArrayWithCellIds:removed.data() count:counts.removedCount];
+    }
+    return [self cellIDArrayWithCellIds:cellIds.data() count:counts.cellCount];
+}
+
++ (NSArray<MCS2CellID *> *)cellIDArrayWithCellIds:(uint64_t const *)cellIds count:(size_t)count
+{
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity:count];
+    for (size_t i = 0; i < count; ++i)
+    {
+        [result addObject:[self cellIDWithWithCellId:S2CellId(cellIds[i])]];
+    }
     return result;
 }
 
++ (void)enableCoveringCacheWithQuantizationLevel:(int)quantizationLevel
+                                    memoryBudget:(NSUInteger)memoryBudget
+{
+    MCS2EnableCoveringCache(quantizationLevel, memoryBudget);
+}
+
++ (void)disableCoveringCache
+{
+    MCS2DisableCoveringCache();
+}
+
++ (MCS2CoveringCacheStatistics)coveringCacheStatistics
+{
+    return MCS2GetCoveringCacheStatistics();
+}
+
 - (instancetype)parent
 {
     return [[self class] cellIDWithWithCellId:self.cellId.parent()];
@@ -0,0 +1,240 @@
+//
+//  MCS2Covering.cc
+//  pgoapi
+//
+//  Copyright © 2016 MC. All rights reserved.
+//
+
+#include "MCS2Covering.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// The S2 library uses deprecated data types. This silences these warnings.
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-W#warnings"
+#endif
+
+#include <s2.h>
+#include <s2cellid.h>
+#include <s2latlng.h>
+#include <s2cap.h>
+#include <s2regioncoverer.h>
+#include <s2coveringcache.h>
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#define EARTH_RADIUS 6371.0 * 1000.0
+
+// Coverings are requested continuously from many threads. Each thread keeps
+// its own coverer and buffers so that their storage stays warm between
+// calls, and a warmed up covering doesn't touch the allocator at all. The
+// buffers are only valid until the thread's next covering.
+struct MCS2CoveringWorkspace
+{
+    S2RegionCoverer coverer;
+    std::vector<S2CellId> cells;
+    std::vector<S2CellId> previous;
+    std::vector<S2CellId> added;
+    std::vector<S2CellId> removed;
+};
+
+static MCS2CoveringWorkspace& threadCoveringWorkspace()
+{
+    static thread_local MCS2CoveringWorkspace workspace;
+    return workspace;
+}
+
+static S2Cap capForRegion(double latitude, double longitude, double radius)
+{
+    S2Point axis = S2LatLng::FromDegrees(latitude, longitude).ToPoint();
+    S1Angle angle = S1Angle::Degrees(360*radius/(2.0 * M_PI * EARTH_RADIUS));
+    return S2Cap::FromAxisAngle(axis, angle);
+}
+
+static void configureCoverer(S2RegionCoverer& coverer, int level, int maxCells)
+{
+    coverer.set_min_level(level);
+    coverer.set_max_level(level);
+    coverer.set_max_cells(maxCells);
+}
+
+// The optional covering cache. Readers take their own reference under the
+// lock, so the cache can be replaced while other threads are still using it.
+static std::shared_ptr<S2CoveringCache> coveringCache;
+static pthread_mutex_t coveringCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static std::shared_ptr<S2CoveringCache> currentCoveringCache()
+{
+    pthread_mutex_lock(&coveringCacheMutex);
+    std::shared_ptr<S2CoveringCache> cache = coveringCache;
+    pthread_mutex_unlock(&coveringCacheMutex);
+    return cache;
+}
+
+static void setCoveringCache(std::shared_ptr<S2CoveringCache> const& cache)
+{
+    pthread_mutex_lock(&coveringCacheMutex);
+    coveringCache = cache;
+    pthread_mutex_unlock(&coveringCacheMutex);
+}
+
+// Computes the covering of the given region with the calling thread's
+// coverer. The result is either owned by the workspace or held by cached,
+// and is valid until the thread's next covering.
+static std::vector<S2CellId> const& coverRegion(double latitude,
+                                                double longitude,
+                                                double radius,
+                                                int level,
+                                                int maxCells,
+                                                S2CoveringCache::Covering *cached)
+{
+    S2Cap cap = capForRegion(latitude, longitude, radius);
+    MCS2CoveringWorkspace& workspace = threadCoveringWorkspace();
+    S2RegionCoverer& coverer = workspace.coverer;
+    
+    configureCoverer(coverer, level, maxCells);
+    
+    std::shared_ptr<S2CoveringCache> cache = currentCoveringCache();
+    if (cache)
+    {
+        *cached = cache->GetCovering(&coverer, cap);
+        return **cached;
+    }
+    coverer.GetCapCovering(cap, &workspace.cells);
+    return workspace.cells;
+}
+
+// S2CellId is a wrapper around its 64 bit id, so coverings can be copied out
+// directly.
+static_assert(sizeof(S2CellId) == sizeof(uint64_t), "S2CellId must be 64 bits");
+
+// Copies up to capacity of cells to buffer.
+static void copyCellIDs(std::vector<S2CellId> const& cells,
+                        uint64_t *buffer,
+                        size_t capacity)
+{
+    size_t count = std::min(cells.size(), capacity);
+    if (count > 0)
+    {
+        memcpy(buffer, cells.data(), count * sizeof(uint64_t));
+    }
+}
+
+size_t MCS2GetCellIDsForRegion(double latitude,
+                               double longitude,
+                               double radius,
+                               int level,
+                               int maxCells,
+                               uint64_t *cellIds,
+                               size_t capacity)
+{
+    S2CoveringCache::Covering cached;
+    std::vector<S2CellId> const& covering =
+        coverRegion(latitude, longitude, radius, level, maxCells, &cached);
+    
+    copyCellIDs(covering, cellIds, capacity);
+    return covering.size();
+}
+
+uint64_t *MCS2CopyCellIDsForRegion(double latitude,
+                                   double longitude,
+                                   double radius,
+                                   int level,
+                                   int maxCells)
+{
+    S2CoveringCache::Covering cached;
+    std::vector<S2CellId> const& covering =
+        coverRegion(latitude, longitude, radius, level, maxCells, &cached);
+    
+    size_t count = covering.size();
+    uint64_t *result = static_cast<uint64_t *>(malloc((count + 1) * sizeof(uint64_t)));
+    if (result)
+    {
+        result[0] = count;
+        if (count > 0)
+        {
+            memcpy(result + 1, covering.data(), count * sizeof(uint64_t));
+        }
+    }
+    return result;
+}
+
+void MCS2FreeCellIDs(uint64_t *cellIds)
+{
+    free(cellIds);
+}
+
+MCS2CellIDDeltaCounts MCS2GetCellIDDeltaForRegion(double latitude,
+                                                  double longitude,
+                                                  double radius,
+                                                  int level,
+                                                  int maxCells,
+                                                  uint64_t const *previousCellIds,
+                                                  size_t previousCount,
+                                                  uint64_t *cellIds,
+                                                  size_t cellCapacity,
+                                                  uint64_t *addedCellIds,
+                                                  size_t addedCapacity,
+                                                  uint64_t *removedCellIds,
+                                                  size_t removedCapacity)
+{
+    S2Cap cap = capForRegion(latitude, longitude, radius);
+    MCS2CoveringWorkspace& workspace = threadCoveringWorkspace();
+    S2RegionCoverer& coverer = workspace.coverer;
+    
+    configureCoverer(coverer, level, maxCells);
+    
+    S2CellId const *previous = reinterpret_cast<S2CellId const *>(previousCellIds);
+    workspace.previous.assign(previous, previous + previousCount);
+    // The previous covering usually comes from an earlier call and is
+    // already sorted, but sorting here keeps the merge in
+    // GetCapCoveringDelta applicable.
+    std::sort(workspace.previous.begin(), workspace.previous.end());
+    
+    coverer.GetCapCoveringDelta(cap, workspace.previous, &workspace.cells,
+                                &workspace.added, &workspace.removed);
+    
+    copyCellIDs(workspace.cells, cellIds, cellCapacity);
+    copyCellIDs(workspace.added, addedCellIds, addedCapacity);
+    copyCellIDs(workspace.removed, removedCellIds, removedCapacity);
+    MCS2CellIDDeltaCounts counts;
+    counts.cellCount = workspace.cells.size();
+    counts.addedCount = workspace.added.size();
+    counts.removedCount = workspace.removed.size();
+    return counts;
+}
+
+void MCS2EnableCoveringCache(int quantizationLevel, size_t memoryBudget)
+{
+    setCoveringCache(std::make_shared<S2CoveringCache>(quantizationLevel, memoryBudget));
+}
+
+void MCS2DisableCoveringCache(void)
+{
+    setCoveringCache(nullptr);
+}
+
+MCS2CoveringCacheStatistics MCS2GetCoveringCacheStatistics(void)
+{
+    MCS2CoveringCacheStatistics statistics = {};
+    std::shared_ptr<S2CoveringCache> cache = currentCoveringCache();
+    if (cache)
+    {
+        statistics.hits = cache->hits();
+        statistics.misses = cache->misses();
+        statistics.evictions = cache->evictions();
+        statistics.entryCount = cache->num_entries();
+        statistics.bytesUsed = cache->bytes_used();
+    }
+    return statistics;
+}
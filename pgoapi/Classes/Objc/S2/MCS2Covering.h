@@ -0,0 +1,113 @@
+//
+//  MCS2Covering.h
+//  pgoapi
+//
+//  Copyright © 2016 MC. All rights reserved.
+//
+
+#ifndef MCS2Covering_h
+#define MCS2Covering_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Plain C interface to the region coverings used by MCS2CellID. Cell ids are
+ * returned as sorted arrays of uint64_t, with no per-cell object allocation,
+ * so callers (including Swift) can consume them directly. This interface
+ * does not depend on the Objective C runtime.
+ *
+ * All functions are thread safe. Each thread keeps its own coverer, so
+ * repeated coverings of similar regions don't allocate.
+ */
+
+typedef struct
+{
+    size_t cellCount;
+    size_t addedCount;
+    size_t removedCount;
+} MCS2CellIDDeltaCounts;
+
+typedef struct
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entryCount;
+    size_t bytesUsed;
+} MCS2CoveringCacheStatistics;
+
+/**
+ * Computes the cells at the given level that intersect the disc of the given
+ * radius (in metres) around latitude, longitude (in degrees), and writes up
+ * to capacity of their ids, sorted in increasing order, to cellIds. Returns
+ * the number of cells in the covering; if this is larger than capacity, call
+ * again with a buffer of at least that many elements.
+ */
+size_t MCS2GetCellIDsForRegion(double latitude,
+                               double longitude,
+                               double radius,
+                               int level,
+                               int maxCells,
+                               uint64_t *cellIds,
+                               size_t capacity);
+
+/**
+ * Like MCS2GetCellIDsForRegion, but returns a malloc'd buffer whose first
+ * element is the number of cell ids that follow it. The buffer must be
+ * released with MCS2FreeCellIDs. Returns NULL if it can't be allocated.
+ */
+uint64_t *MCS2CopyCellIDsForRegion(double latitude,
+                                   double longitude,
+                                   double radius,
+                                   int level,
+                                   int maxCells);
+void MCS2FreeCellIDs(uint64_t *cellIds);
+
+/**
+ * Like MCS2GetCellIDsForRegion, but also finds the cells that were added to
+ * and removed from previousCellIds, the previousCount cells of a covering
+ * returned by an earlier call with the same radius, level and maxCells. Only
+ * the changed cells need to be requested again as the location moves.
+ *
+ * Writes up to cellCapacity, addedCapacity and removedCapacity ids, sorted in
+ * increasing order, to cellIds, addedCellIds and removedCellIds, and returns
+ * the full number of each. If any of them is larger than its capacity, call
+ * again with buffers of at least that many elements. This does not use the
+ * covering cache.
+ */
+MCS2CellIDDeltaCounts MCS2GetCellIDDeltaForRegion(double latitude,
+                                                  double longitude,
+                                                  double radius,
+                                                  int level,
+                                                  int maxCells,
+                                                  uint64_t const *previousCellIds,
+                                                  size_t previousCount,
+                                                  uint64_t *cellIds,
+                                                  size_t cellCapacity,
+                                                  uint64_t *addedCellIds,
+                                                  size_t addedCapacity,
+                                                  uint64_t *removedCellIds,
+                                                  size_t removedCapacity);
+
+/**
+ * Enables a shared, bounded LRU cache for region coverings. Locations are
+ * snapped to the centre of the cell at quantizationLevel that contains them,
+ * so nearby requests (e.g. level 20 cells are roughly 10m across) share a
+ * single covering. The least recently used coverings are evicted once the
+ * cache uses more than memoryBudget bytes. Calling this again replaces the
+ * cache and resets its statistics.
+ */
+void MCS2EnableCoveringCache(int quantizationLevel, size_t memoryBudget);
+void MCS2DisableCoveringCache(void);
+MCS2CoveringCacheStatistics MCS2GetCoveringCacheStatistics(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MCS2Covering_h */
@@ -8,19 +8,87 @@
 
 import Foundation
 
+// Max values allowed by server according to this comment:
+// https://github.com/AeonLucid/POGOProtos/issues/83#issuecomment-235612285
+private let maxRadius = 1500
+private let cellLevel = Int32(15)
+private let maxCells = Int32(100) //100 is max allowed by the server
+
+// The level is fixed, so maxCells doesn't limit the covering. A maxRadius cap
+// covers about 130 cells at level 15 and up to about 180 near cube face
+// corners, where the cells are smallest.
+private let maxCoveringCells = 256
+
 func getCellIDs(_ location: Location, radius: Int = 1000) -> [UInt64]
 {
-    // Max values allowed by server according to this comment:
-    // https://github.com/AeonLucid/POGOProtos/issues/83#issuecomment-235612285
-    let r = min(radius, 1500)
-    let level = Int32(15)
-    let maxCells = Int32(100) //100 is max allowed by the server
+    let r = min(radius, maxRadius)
+    
+    // The covering is written straight into the array, already sorted. The
+    // buffer fits the largest covering of any radius up to maxRadius, so it
+    // only grows if that estimate is wrong.
+    var cells = [UInt64](repeating: 0, count: maxCoveringCells)
+    var count = 0
+    repeat
+    {
+        if count > cells.count
+        {
+            cells = [UInt64](repeating: 0, count: count)
+        }
+        count = MCS2GetCellIDsForRegion(location.latitude,
+                                        location.longitude,
+                                        Double(r),
+                                        cellLevel,
+                                        maxCells,
+                                        &cells,
+                                        cells.count)
+    } while count > cells.count
+    
+    cells.removeSubrange(count..<cells.count)
+    return cells
+}
+
+// Returns the cell ids for location, along with the ids that were added to and
+// removed from previous (the result of an earlier call to getCellIDs or
+// getCellIDDelta with the same radius) as the location moved.
+func getCellIDDelta(_ location: Location, previous: [UInt64], radius: Int = 1000)
+    -> (cellIDs: [UInt64], added: [UInt64], removed: [UInt64])
+{
+    let r = min(radius, maxRadius)
     
-    let cells = MCS2CellID.cellIDsForRegion(atLat: location.latitude,
-                                                 long: location.longitude,
-                                                 radius: Double(r),
-                                                 level: level,
-                                                 maxCellCount: maxCells)
+    // A moving location adds and removes only a few cells, so the buffers
+    // start small and grow only when the returned counts don't fit.
+    var cells = [UInt64](repeating: 0, count: max(previous.count, maxCoveringCells))
+    var added = [UInt64](repeating: 0, count: Int(maxCells))
+    var removed = [UInt64](repeating: 0, count: Int(maxCells))
+    var counts = MCS2CellIDDeltaCounts()
+    while true
+    {
+        counts = MCS2GetCellIDDeltaForRegion(location.latitude,
+                                             location.longitude,
+                                             Double(r),
+                                             cellLevel,
+                                             maxCells,
+                                             previous,
+                                             previous.count,
+                                             &cells,
+                                             cells.count,
+                                             &added,
+                                             added.count,
+                                             &removed,
+                                             removed.count)
+        if counts.cellCount <= cells.count &&
+            counts.addedCount <= added.count &&
+            counts.removedCount <= removed.count
+        {
+            break
+        }
+        cells = [UInt64](repeating: 0, count: max(cells.count, counts.cellCount))
+        added = [UInt64](repeating: 0, count: max(added.count, counts.addedCount))
+        removed = [UInt64](repeating: 0, count: max(removed.count, counts.removedCount))
+    }
     
-    return cells.map({ $0.cellID }).sorted()
+    cells.removeSubrange(counts.cellCount..<cells.count)
+    added.removeSubrange(counts.addedCount..<added.count)
+    removed.removeSubrange(counts.removedCount..<removed.count)
+    return (cells, added, removed)
 }
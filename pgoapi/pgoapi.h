@@ -15,3 +15,4 @@ FOUNDATION_EXPORT double pgoapiVersionNumber;
 FOUNDATION_EXPORT const unsigned char pgoapiVersionString[];
 
 #import <pgoapi/MCS2CellID.h>
+#import <pgoapi/MCS2Covering.h>